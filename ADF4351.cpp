@@ -7,143 +7,2131 @@
 
 #include "ADF4351.h"
 
+// Interrupt masking around state shared with interrupt handlers. The
+// previous mask (SREG on AVR, PRIMASK on Cortex-M) is restored rather than
+// interrupts re-enabled, so a caller's critical section or an ISR stays
+// masked after the library returns.
+#if defined(__AVR__)
+#define ADF4351_LOCK() uint8_t sreg = SREG; cli()
+#define ADF4351_UNLOCK() SREG = sreg
+#elif defined(__ARM_ARCH_6M__) || defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || \
+      defined(__ARM_ARCH_8M_BASE__) || defined(__ARM_ARCH_8M_MAIN__)
+#define ADF4351_LOCK() uint32_t primask; \
+    __asm__ volatile("mrs %0, primask\n\tcpsid i" : "=r"(primask) : : "memory")
+#define ADF4351_UNLOCK() __asm__ volatile("msr primask, %0" : : "r"(primask) : "memory")
+#else
+// No portable way to read the mask: interrupts are re-enabled on unlock
+#define ADF4351_LOCK() noInterrupts()
+#define ADF4351_UNLOCK() interrupts()
+#endif
+
+#ifdef ADF4351_STATS
+#define ADF4351_STATS_ONLY(x) x
+#else
+#define ADF4351_STATS_ONLY(x)
+#endif
+
 ADF4351::ADF4351(uint8_t lePin) 
-    : _lePin(lePin),
-      _refFreqMHz(25.0),
-      _outputFreqMHz(0.0),
-      _pfdFreqMHz(25.0),
+    : _refCorrectionPpb(0),
+      _outputFreqHz(0),
+      _sleeping(false),
+      _lePin(lePin),
+      _refFreqHz(25000000UL),
+      _actualFreqHz(0),
+      _channelSpacingHz(10000UL),
+      _pfdNumHz(25000000UL),
+      _pfdDen(1),
+      _regValid(0),
+      _sweepActive(false),
+      _sweepStepHz(0),
+      _sweepDivSel(0),
+      _sweepRem(0),
+      _sweepStepInt(0),
+      _sweepStepFrac(0),
+      _sweepStepRem(0),
+      _sweepNominalHz(0),
+      _sweepNomRem(0),
+      _sweepNomStepHz(0),
+      _sweepNomStepRem(0),
+      _sweepUnitFrac(0),
+      _sweepUnitRem(0),
+      _tuneUs(0),
+      _requestPending(false),
+      _requestFreqHz(0),
+      _requestSpacingHz(10000UL),
+      _requestsCoalesced(0),
+      _hopTable(NULL),
+      _hopCount(0),
+      _hopSpacingHz(10000UL),
+      _generation(1),
+      _wakeTimeUs(0),
+      _rampWords(NULL),
+      _rampLength(0),
+      _rampIndex(0),
+      _rampDir(1),
+      _rampShape(ADF4351_RAMP_SAWTOOTH),
+      _keyAltFreqHz(0),
+      _keyAltActualHz(0),
+      _keyBits(NULL),
+      _keyBitCount(0),
+      _keyIndex(0),
+      _keyReg(0),
       _rCounter(1),
       _refDoubler(0),
       _refDiv2(0),
       _outputPower(3),
       _rfOutputEnable(1),
       _chargePumpCurr(7) {
+    for (uint8_t i = 0; i < 6; i++) {
+        _reg[i] = i;
+    }
+    
+#if ADF4351_CACHE_SIZE > 0
+    _cacheHits = 0;
+    _cacheMisses = 0;
+#endif
+    clearCache();
+    clearTrace();
+#ifdef ADF4351_SCHEDULE
+    _schedule = NULL;
+    _scheduleCapacity = 0;
+    _scheduleCount = 0;
+    _planGeneration = 1;
+    _busBusy = false;
+    _scheduleDeferred = false;
+    resetScheduleStats();
+#endif
+    ADF4351_STATS_ONLY(resetStats();)
+#ifdef ADF4351_LOCK_HISTOGRAM
+    _lockPercentile = 99;
+    clearLockHistogram();
+#endif
+}
+
+void ADF4351::beginHz(uint32_t refFreqHz) {
+    trace(ADF4351_TRACE_BEGIN, refFreqHz);
+    _refFreqHz = refFreqHz;
+    
+    // Initialize LE pin
+    pinMode(_lePin, OUTPUT);
+    digitalWrite(_lePin, HIGH);
+    
+    // Chip state is unknown until every register has been written once
+    _regValid = 0;
+    _sleeping = false;
+    
+    // Initialize SPI
+    SPI.begin();
+    SPI.setDataMode(SPI_MODE0);
+    SPI.setBitOrder(MSBFIRST);
+    
+    // Calculate PFD frequency
+    _pfdNumHz = _refFreqHz * (1 + _refDoubler);
+    _pfdDen = _rCounter * (1 + _refDiv2);
+    stopStreams();
+    invalidateRegisters();
+}
+
+bool ADF4351::setReferenceCorrectionPpb(int32_t ppb) {
+    if (ppb < -1000000L || ppb > 1000000L) {
+        return false;
+    }
+    
+    // The programmed frequency must stay reachable: near the band edges a
+    // large correction moves the nominal frequency out of the VCO range
+    bool programmed = (_actualFreqHz != 0);
+    if (programmed) {
+        int32_t previous = _refCorrectionPpb;
+        uint32_t regs[6];
+        _refCorrectionPpb = ppb;
+        bool valid = computeRegistersHz(_outputFreqHz, _channelSpacingHz, regs);
+        _refCorrectionPpb = previous;
+        if (!valid) {
+            return false;
+        }
+    }
+    
+    trace(ADF4351_TRACE_SET_CORRECTION, (uint32_t)ppb);
+    _refCorrectionPpb = ppb;
+    invalidateRegisters();
+    
+    // Only the programmed frequency is recomputed now
+    if (programmed) {
+        return setFrequencyHz(_outputFreqHz, _channelSpacingHz);
+    }
+    return true;
+}
+
+int32_t ADF4351::getReferenceCorrectionPpb() const {
+    return _refCorrectionPpb;
+}
+
+bool ADF4351::setReferenceAutoHz(uint32_t refFreqHz, uint32_t channelSpacingHz,
+                                 ADF4351ReferenceConfig *config) {
+    if (refFreqHz == 0 || channelSpacingHz == 0) {
+        return false;
+    }
+    
+    bool found = false;
+    bool bestExact = false;
+    uint32_t bestNum = 0;
+    uint16_t bestDen = 1;
+    uint8_t bestR = 1;
+    uint8_t bestD = 0;
+    uint8_t bestT = 0;
+    
+    for (uint8_t d = 0; d <= 1; d++) {
+        // The doubler is only specified for references up to 30 MHz
+        if (d && refFreqHz > 30000000UL) {
+            break;
+        }
+        for (uint8_t t = 0; t <= 1; t++) {
+            uint32_t num = refFreqHz * (1 + d);
+            for (uint16_t r = 1; r <= 255; r++) {
+                uint16_t den = r * (1 + t);
+                
+                // The PFD falls as R rises: stop once nothing better is left
+                if (found && bestExact && (uint64_t)num * bestDen < (uint64_t)bestNum * den) {
+                    break;
+                }
+                
+                uint64_t stepDen = (uint64_t)den * channelSpacingHz;
+                bool integerN = ((uint64_t)channelSpacingHz * den) % num == 0;
+                uint32_t limitHz = integerN ? 45000000UL : 32000000UL;
+                if (num > (uint64_t)limitHz * den) {
+                    continue;
+                }
+                if (!integerN && num > 4095 * stepDen) {
+                    continue;
+                }
+                bool exact = integerN || num % stepDen == 0;
+                
+                // Rank by exactness, then PFD
+                bool better = !found || (exact && !bestExact) ||
+                              (exact == bestExact && (uint64_t)num * bestDen > (uint64_t)bestNum * den);
+                if (better) {
+                    found = true;
+                    bestExact = exact;
+                    bestNum = num;
+                    bestDen = den;
+                    bestR = (uint8_t)r;
+                    bestD = d;
+                    bestT = t;
+                }
+            }
+        }
+    }
+    
+    if (!found) {
+        return false;
+    }
+    
+    // Check the programmed frequency against the new PFD before changing anything
+    bool programmed = (_actualFreqHz != 0);
+    if (programmed) {
+        FrequencyWords w;
+        uint16_t mod = calcModulus(channelSpacingHz, bestNum, bestDen);
+        if (!calcFrequencyWords(toNominalHz(_outputFreqHz), mod, bestNum, bestDen, w)) {
+            return false;
+        }
+    }
+    
+    applyReference(refFreqHz, bestR, bestD, bestT, channelSpacingHz, config);
+    if (config != NULL) {
+        config->integerNCount = 0;
+    }
+    if (programmed) {
+        return setFrequencyHz(_outputFreqHz, channelSpacingHz);
+    }
+    return true;
+}
+
+bool ADF4351::planReferenceHz(uint32_t refFreqHz, ADF4351HopEntry *table, uint16_t count,
+                              uint32_t channelSpacingHz, ADF4351ReferenceConfig *config) {
+    if (refFreqHz == 0 || channelSpacingHz == 0 || table == NULL || count == 0) {
+        return false;
+    }
+    for (uint16_t n = 0; n < count; n++) {
+        if (!inRange(table[n].freqHz)) {
+            return false;
+        }
+    }
+    
+    bool found = false;
+    uint16_t bestCount = 0;
+    uint32_t bestNum = 0;
+    uint16_t bestDen = 1;
+    uint8_t bestR = 1;
+    uint8_t bestD = 0;
+    uint8_t bestT = 0;
+    
+    for (uint8_t d = 0; d <= 1; d++) {
+        if (d && refFreqHz > 30000000UL) {
+            break;
+        }
+        for (uint8_t t = 0; t <= 1; t++) {
+            uint32_t num = refFreqHz * (1 + d);
+            for (uint16_t r = 1; r <= 255; r++) {
+                uint16_t den = r * (1 + t);
+                
+                // Nothing below the best PFD can beat a plan that is all integer-N
+                if (found && bestCount == count && (uint64_t)num * bestDen < (uint64_t)bestNum * den) {
+                    break;
+                }
+                if (num > 45000000ULL * den) {
+                    continue;
+                }
+                
+                // N is an integer when VCO * den is a multiple of num, and
+                // must fit the 16-bit INT field for every entry
+                uint16_t integerCount = 0;
+                bool fits = true;
+                for (uint16_t n = 0; n < count && fits; n++) {
+                    uint8_t divider;
+                    uint8_t divSel;
+                    uint64_t freqHz = toNominalHz(table[n].freqHz);
+                    selectOutputDivider(freqHz, divider, divSel);
+                    uint64_t nScaled = freqHz * divider * den;
+                    fits = nScaled < 65536ULL * num;
+                    if (nScaled % num == 0) {
+                        integerCount++;
+                    }
+                }
+                if (!fits) {
+                    continue;
+                }
+                
+                // Any fractional-N entry brings back the fractional PFD and MOD limits
+                if (integerCount < count &&
+                    (num > 32000000ULL * den || num > 4095ULL * den * channelSpacingHz)) {
+                    continue;
+                }
+                
+                bool better = !found || integerCount > bestCount ||
+                              (integerCount == bestCount && (uint64_t)num * bestDen > (uint64_t)bestNum * den);
+                if (better) {
+                    found = true;
+                    bestCount = integerCount;
+                    bestNum = num;
+                    bestDen = den;
+                    bestR = (uint8_t)r;
+                    bestD = d;
+                    bestT = t;
+                }
+            }
+        }
+    }
+    
+    if (!found) {
+        return false;
+    }
+    
+    applyReference(refFreqHz, bestR, bestD, bestT, channelSpacingHz, config);
+    if (config != NULL) {
+        config->integerNCount = bestCount;
+    }
+    return setHopTable(table, count, channelSpacingHz);
+}
+
+void ADF4351::applyReference(uint32_t refFreqHz, uint8_t rCounter, uint8_t refDoubler, uint8_t refDiv2,
+                             uint32_t channelSpacingHz, ADF4351ReferenceConfig *config) {
+    uint32_t prevNum = _pfdNumHz;
+    uint16_t prevDen = _pfdDen;
+    setReferenceHz(refFreqHz, rCounter, refDoubler, refDiv2);
+    if (config == NULL) {
+        return;
+    }
+    
+    uint64_t stepDen = (uint64_t)_pfdDen * channelSpacingHz;
+    config->rCounter = rCounter;
+    config->refDoubler = refDoubler;
+    config->refDiv2 = refDiv2;
+    config->integerN = ((uint64_t)channelSpacingHz * _pfdDen) % _pfdNumHz == 0;
+    config->exact = config->integerN || _pfdNumHz % stepDen == 0;
+    config->mod = calcModulus(channelSpacingHz, _pfdNumHz, _pfdDen);
+    config->pfdHz = getPFDFrequencyHz();
+    config->prevPfdHz = (prevNum + prevDen / 2) / prevDen;
+    config->bandSelectUs = bandSelectTimeUs(_pfdNumHz, _pfdDen);
+    config->prevBandSelectUs = bandSelectTimeUs(prevNum, prevDen);
+}
+
+uint32_t ADF4351::bandSelectTimeUs(uint32_t pfdNumHz, uint16_t pfdDen) const {
+    // Only the band select clock divider matters here; it does not depend on the frequency
+    FrequencyWords w;
+    w.nInt = 0;
+    w.nFrac = 0;
+    w.mod = 1;
+    w.rfDivSel = 0;
+    uint32_t regs[6];
+    buildRegisters(w, regs);
+    uint32_t bandSelDiv = (regs[4] >> 12) & 0xFF;
+    
+    uint64_t cyclesDen = (uint64_t)ADF4351_BAND_SELECT_CYCLES * bandSelDiv * pfdDen * 1000000ULL;
+    return (uint32_t)((cyclesDen + pfdNumHz / 2) / pfdNumHz);
+}
+
+bool ADF4351::begin(const ADF4351SavedState &state) {
+    if (state.magic[0] != 'A' || state.magic[1] != 'D' || state.magic[2] != 'F' ||
+        state.magic[3] != 'S' || state.version != 2 ||
+        state.checksum != stateChecksum(state) || state.rCounter == 0) {
+        return false;
+    }
+    
+    _rCounter = state.rCounter;
+    _refDoubler = state.refDoubler;
+    _refDiv2 = state.refDiv2;
+    _outputPower = state.outputPower;
+    _rfOutputEnable = state.rfOutputEnable;
+    _chargePumpCurr = state.chargePumpCurr;
+    _refCorrectionPpb = state.refCorrectionPpb;
+    beginHz(state.refFreqHz);
+    
+    // The saved words already encode all of the above; write them as they are
+    _outputFreqHz = state.outputFreqHz;
+    storeRegisters(state.regs, state.channelSpacingHz, state.actualFreqHz);
+    writeRegisters(state.regs, 0x3F);
+    return true;
+}
+
+bool ADF4351::saveState(ADF4351SavedState &state) const {
+    if (_regValid != 0x3F || _actualFreqHz == 0) {
+        return false;
+    }
+    
+    state.outputFreqHz = _outputFreqHz;
+    state.actualFreqHz = _actualFreqHz;
+    for (uint8_t i = 0; i < 6; i++) {
+        state.regs[i] = _reg[i];
+    }
+    state.refFreqHz = _refFreqHz;
+    state.channelSpacingHz = _channelSpacingHz;
+    state.refCorrectionPpb = _refCorrectionPpb;
+    state.magic[0] = 'A';
+    state.magic[1] = 'D';
+    state.magic[2] = 'F';
+    state.magic[3] = 'S';
+    state.version = 2;
+    state.rCounter = _rCounter;
+    state.refDoubler = _refDoubler;
+    state.refDiv2 = _refDiv2;
+    state.outputPower = _outputPower;
+    state.rfOutputEnable = _rfOutputEnable;
+    state.chargePumpCurr = _chargePumpCurr;
+    state.reserved = 0;
+    state.checksum = stateChecksum(state);
+    return true;
+}
+
+uint64_t ADF4351::fromNominalHz(uint64_t nominalHz) const {
+    if (_refCorrectionPpb == 0) {
+        return nominalHz;
+    }
+    uint64_t scale = 1000000000ULL + _refCorrectionPpb;
+    return (nominalHz * scale + 500000000ULL) / 1000000000ULL;
+}
+
+uint16_t ADF4351::stateChecksum(const ADF4351SavedState &state) {
+    // The state is short enough that both sums fit without reducing on
+    // every byte (sum1 < 2^16, sum2 < 2^24); one modulo at the end gives
+    // the same result and keeps the warm start free of per-byte divisions
+    const uint8_t *bytes = (const uint8_t *)&state;
+    uint16_t sum1 = 0;
+    uint32_t sum2 = 0;
+    for (size_t n = 0; n < offsetof(ADF4351SavedState, checksum); n++) {
+        sum1 += bytes[n];
+        sum2 += sum1;
+    }
+    return (uint16_t)(((sum2 % 255) << 8) | (sum1 % 255));
+}
+
+void ADF4351::setReferenceHz(uint32_t refFreqHz, uint8_t rCounter, uint8_t refDoubler, uint8_t refDiv2) {
+    trace(ADF4351_TRACE_SET_REFERENCE, refFreqHz);
+    _refFreqHz = refFreqHz;
+    _rCounter = rCounter;
+    _refDoubler = refDoubler;
+    _refDiv2 = refDiv2;
+    
+    // Recalculate PFD frequency
+    _pfdNumHz = _refFreqHz * (1 + _refDoubler);
+    _pfdDen = _rCounter * (1 + _refDiv2);
+    stopStreams();
+    invalidateRegisters();
+}
+
+bool ADF4351::setFrequencyHz(uint64_t freqHz, uint32_t channelSpacingHz) {
+    return setFrequencyHz(freqHz, channelSpacingHz, NULL);
+}
+
+bool ADF4351::setFrequencyHz(uint64_t freqHz, uint32_t channelSpacingHz, ComputeFunction compute) {
+    // Validate frequency range
+    if (!inRange(freqHz)) {
+        return false;
+    }
+    
+    ADF4351_STATS_ONLY(_stats.setFrequencyCalls++;)
+    trace(ADF4351_TRACE_SET_FREQUENCY, (uint32_t)(freqHz / 1000));
+    
+    _outputFreqHz = freqHz;
+    stopStreams();
+    return updateRegisters(channelSpacingHz, compute);
+}
+
+bool ADF4351::beginSweepHz(uint64_t startHz, int32_t stepHz, uint32_t channelSpacingHz) {
+    if (!setFrequencyHz(startHz, channelSpacingHz)) {
+        return false;
+    }
+    
+    _sweepStepHz = stepHz;
+    resetSweepState();
+    _sweepActive = true;
+    return true;
+}
+
+bool ADF4351::nextSweepStep() {
+    if (!_sweepActive) {
+        return false;
+    }
+    
+    int64_t nextHz = (int64_t)_outputFreqHz + _sweepStepHz;
+    if (nextHz < 0 || !inRange((uint64_t)nextHz)) {
+        _sweepActive = false;
+        return false;
+    }
+    _outputFreqHz = (uint64_t)nextHz;
+    trace(ADF4351_TRACE_SWEEP_STEP, (uint32_t)(_outputFreqHz / 1000));
+    
+    // The nominal frequency moves by the nominal step, plus 1 Hz whenever
+    // the remainder of the reference correction carries
+    uint32_t scale = 1000000000UL + _refCorrectionPpb;
+    bool unit = false;
+    if (_sweepStepHz >= 0) {
+        _sweepNomRem += _sweepNomStepRem;
+        if (_sweepNomRem >= scale) {
+            _sweepNomRem -= scale;
+            unit = true;
+        }
+        _sweepNominalHz += _sweepNomStepHz + unit;
+    } else {
+        if (_sweepNomRem < _sweepNomStepRem) {
+            _sweepNomRem += scale;
+            unit = true;
+        }
+        _sweepNomRem -= _sweepNomStepRem;
+        _sweepNominalHz -= _sweepNomStepHz + unit;
+    }
+    
+    // Crossing an output divider boundary changes R4 and the N step size; a
+    // negative correction can also push the nominal frequency past the VCO
+    uint8_t outputDivider;
+    uint8_t rfDivSel;
+    selectOutputDivider(_sweepNominalHz, outputDivider, rfDivSel);
+    if (rfDivSel != _sweepDivSel || _sweepStepInt == 0xFFFF || !inRange(_sweepNominalHz)) {
+        return fullSweepStep();
+    }
+    
+    FrequencyWords w;
+    w.nInt = (_reg[0] >> 15) & 0xFFFF;
+    w.nFrac = (_reg[0] >> 3) & 0xFFF;
+    w.mod = (_reg[1] >> 3) & 0xFFF;
+    w.rfDivSel = rfDivSel;
+    
+    if (_sweepStepHz >= 0) {
+        // Add with carry from remainder to FRAC to INT
+        int32_t frac = (int32_t)w.nFrac + _sweepStepFrac;
+        _sweepRem += _sweepStepRem;
+        if (_sweepRem >= _pfdNumHz) {
+            _sweepRem -= _pfdNumHz;
+            frac++;
+        }
+        if (unit) {
+            frac += _sweepUnitFrac;
+            _sweepRem += _sweepUnitRem;
+            if (_sweepRem >= _pfdNumHz) {
+                _sweepRem -= _pfdNumHz;
+                frac++;
+            }
+        }
+        // The carry adds at most 2 to INT; past the 16-bit field the
+        // full calculation ends the sweep
+        if ((uint32_t)w.nInt + _sweepStepInt + 2 > 65535) {
+            return fullSweepStep();
+        }
+        w.nInt += _sweepStepInt;
+        while (frac >= w.mod) {
+            frac -= w.mod;
+            w.nInt++;
+        }
+        w.nFrac = (uint16_t)frac;
+    } else {
+        // Subtract with borrow from remainder to FRAC to INT
+        int32_t frac = (int32_t)w.nFrac - _sweepStepFrac;
+        if (_sweepRem < _sweepStepRem) {
+            _sweepRem += _pfdNumHz;
+            frac--;
+        }
+        _sweepRem -= _sweepStepRem;
+        if (unit) {
+            frac -= _sweepUnitFrac;
+            if (_sweepRem < _sweepUnitRem) {
+                _sweepRem += _pfdNumHz;
+                frac--;
+            }
+            _sweepRem -= _sweepUnitRem;
+        }
+        w.nInt -= _sweepStepInt;
+        while (frac < 0) {
+            frac += w.mod;
+            w.nInt--;
+        }
+        w.nFrac = (uint16_t)frac;
+    }
+    
+    // Only the full calculation checks N against the 4/5 prescaler limits
+    if (w.nInt < 75) {
+        return fullSweepStep();
+    }
+    
+    uint32_t regs[6];
+    buildRegisters(w, regs);
+    
+    // Only R0 changes in most steps; R1 (prescaler) and R2 (lock detect
+    // mode) follow INT and FRAC
+    uint8_t dirty = dirtyRegisters(regs);
+    storeRegisters(regs, _channelSpacingHz);
+    writeRegisters(regs, dirty);
+    return true;
+}
+
+uint16_t ADF4351::measureSweepHz(uint64_t startHz, int32_t stepHz, uint16_t count, uint16_t *results,
+                                ADF4351SampleFunction sample, int16_t lockDetectPin,
+                                uint32_t minDwellUs, uint32_t maxDwellUs,
+                                uint32_t channelSpacingHz, ADF4351RampStats *stats) {
+    if (results == NULL || sample == NULL || count == 0) {
+        return 0;
+    }
+    
+    // Double buffer: one set is in the chip while the next is calculated
+    uint32_t regs[2][6];
+    uint64_t actualHz[2];
+    uint64_t freqHz = startHz;
+    if (!inRange(freqHz) || !computeRegistersHz(freqHz, channelSpacingHz, regs[0])) {
+        return 0;
+    }
+    ADF4351RegisterInfo info;
+    decodeRegisters(regs[0], info);
+    actualHz[0] = fromNominalHz(calcOutputFrequencyHz(info, _refFreqHz));
+    stopStreams();
+    
+    uint16_t locked = 0;
+    uint16_t steps = 0;
+    uint32_t minIntervalUs = 0xFFFFFFFFUL;
+    uint32_t maxIntervalUs = 0;
+    uint32_t startUs = micros();
+    uint32_t lastUs = startUs;
+    
+    for (uint16_t k = 0; k < count; k++) {
+        uint32_t *cur = regs[k & 1];
+        
+        // Retune
+        uint32_t tuneUs = micros();
+        trace(ADF4351_TRACE_SWEEP_STEP, (uint32_t)(freqHz / 1000));
+        uint8_t dirty = dirtyRegisters(cur);
+        _outputFreqHz = freqHz;
+        storeRegisters(cur, channelSpacingHz, actualHz[k & 1]);
+        writeRegisters(cur, dirty);
+        
+        if (k > 0) {
+            uint32_t intervalUs = tuneUs - lastUs;
+            if (intervalUs < minIntervalUs) minIntervalUs = intervalUs;
+            if (intervalUs > maxIntervalUs) maxIntervalUs = intervalUs;
+        }
+        lastUs = tuneUs;
+        
+        // Calculate the next step while this one settles
+        uint64_t nextHz = freqHz + stepHz;
+        bool haveNext = false;
+        if (k + 1 < count && inRange(nextHz)) {
+            uint32_t *next = regs[(k + 1) & 1];
+            if (computeRegistersHz(nextHz, channelSpacingHz, next)) {
+                decodeRegisters(next, info);
+                actualHz[(k + 1) & 1] = fromNominalHz(calcOutputFrequencyHz(info, _refFreqHz));
+                haveNext = true;
+            }
+        }
+        
+        // Dwell until lock
+        bool inLock = (lockDetectPin < 0);
+        if (inLock) {
+            while (micros() - tuneUs < maxDwellUs) {
+            }
+        } else {
+            while (micros() - tuneUs < minDwellUs) {
+            }
+            while (!(inLock = (digitalRead(lockDetectPin) == HIGH)) && micros() - tuneUs < maxDwellUs) {
+            }
+            recordLockTime(micros() - _tuneUs, inLock);
+        }
+        
+        results[k] = sample(freqHz);
+        steps++;
+        if (inLock) {
+            locked++;
+        }
+        
+        if (!haveNext) {
+            break;
+        }
+        freqHz = nextHz;
+    }
+    
+    if (stats) {
+        stats->steps = steps;
+        stats->elapsedUs = micros() - startUs;
+        stats->minIntervalUs = (steps > 1) ? minIntervalUs : 0;
+        stats->maxIntervalUs = maxIntervalUs;
+    }
+    return locked;
+}
+
+void ADF4351::requestFrequencyHz(uint64_t freqHz, uint32_t channelSpacingHz) {
+    ADF4351_LOCK();
+    if (_requestPending) {
+        _requestsCoalesced++;
+    }
+    _requestFreqHz = freqHz;
+    _requestSpacingHz = channelSpacingHz;
+    _requestPending = true;
+    ADF4351_UNLOCK();
+}
+
+bool ADF4351::service() {
+    if (!_requestPending) {
+        return false;
+    }
+    
+    ADF4351_LOCK();
+    uint64_t freqHz = _requestFreqHz;
+    uint32_t channelSpacingHz = _requestSpacingHz;
+    _requestPending = false;
+    ADF4351_UNLOCK();
+    
+    return setFrequencyHz(freqHz, channelSpacingHz);
+}
+
+uint32_t ADF4351::getCoalescedRequests() const {
+    return _requestsCoalesced;
+}
+
+bool ADF4351::setHopTable(ADF4351HopEntry *table, uint16_t count, uint32_t channelSpacingHz) {
+    _hopTable = NULL;
+    _hopCount = 0;
+    if (table == NULL) {
+        return false;
+    }
+    
+    for (uint16_t n = 0; n < count; n++) {
+        if (!inRange(table[n].freqHz) ||
+            !computeRegistersHz(table[n].freqHz, channelSpacingHz, table[n].regs)) {
+            return false;
+        }
+        table[n].generation = _generation;
+    }
+    
+    _hopTable = table;
+    _hopCount = count;
+    _hopSpacingHz = channelSpacingHz;
+    return true;
+}
+
+bool ADF4351::hopTo(uint16_t index) {
+    if (_hopTable == NULL || index >= _hopCount) {
+        return false;
+    }
+    
+    ADF4351HopEntry &entry = _hopTable[index];
+    trace(ADF4351_TRACE_SET_FREQUENCY, (uint32_t)(entry.freqHz / 1000));
+    
+    // Settings changed since the words were computed: refresh this entry only
+    if (entry.generation != _generation) {
+        if (!computeRegistersHz(entry.freqHz, _hopSpacingHz, entry.regs)) {
+            return false;
+        }
+        entry.generation = _generation;
+    }
+    
+    uint8_t dirty = dirtyRegisters(entry.regs);
+    _outputFreqHz = entry.freqHz;
+    stopStreams();
+    storeRegisters(entry.regs, _hopSpacingHz);
+    writeRegisters(entry.regs, dirty);
+    return true;
+}
+
+bool ADF4351::prepareRampHz(uint64_t startHz, uint64_t stopHz, uint16_t steps, uint32_t *buffer,
+                            ADF4351RampShape shape, uint32_t channelSpacingHz) {
+    trace(ADF4351_TRACE_PREPARE_RAMP, steps);
+    _rampWords = NULL;
+    if (steps < 2 || buffer == NULL || !inRange(startHz) || !inRange(stopHz)) {
+        return false;
+    }
+    
+    uint32_t first[6];
+    if (!computeRegistersHz(startHz, channelSpacingHz, first)) {
+        return false;
+    }
+    
+    int64_t spanHz = (int64_t)stopHz - (int64_t)startHz;
+    for (uint16_t k = 0; k < steps; k++) {
+        uint64_t freqHz = startHz + spanHz * k / (steps - 1);
+        uint32_t regs[6];
+        if (!computeRegistersHz(freqHz, channelSpacingHz, regs) ||
+            regs[1] != first[1] || regs[4] != first[4]) {
+            return false;
+        }
+        buffer[k] = regs[0];
+    }
+    
+    // Program the start of the ramp
+    uint8_t dirty = dirtyRegisters(first);
+    _outputFreqHz = startHz;
+    stopStreams();
+    storeRegisters(first, channelSpacingHz);
+    writeRegisters(first, dirty);
+    
+    _rampWords = buffer;
+    _rampLength = steps;
+    _rampIndex = 0;
+    _rampDir = 1;
+    _rampShape = shape;
+    return true;
+}
+
+void ADF4351::rampStep() {
+    if (_rampWords == NULL) {
+        return;
+    }
+    
+    // Advance first: the word at index 0 was written by prepareRampHz()
+    if (_rampShape == ADF4351_RAMP_TRIANGLE) {
+        if (_rampIndex + _rampDir >= _rampLength || _rampIndex + _rampDir < 0) {
+            _rampDir = -_rampDir;
+        }
+        _rampIndex += _rampDir;
+    } else {
+        _rampIndex = (_rampIndex + 1 < _rampLength) ? _rampIndex + 1 : 0;
+    }
+    
+    _reg[0] = _rampWords[_rampIndex];
+    writeRegister(_reg[0]);
+}
+
+bool ADF4351::runRamp(uint32_t stepPeriodUs, uint32_t count, ADF4351RampStats *stats) {
+    if (_rampWords == NULL) {
+        return false;
+    }
+    
+    uint32_t minIntervalUs = 0xFFFFFFFFUL;
+    uint32_t maxIntervalUs = 0;
+    uint32_t startUs = micros();
+    uint32_t lastUs = startUs;
+    uint32_t deadlineUs = startUs;
+    
+    for (uint32_t n = 0; n < count; n++) {
+        // Pace against absolute deadlines so errors do not accumulate
+        deadlineUs += stepPeriodUs;
+        while ((int32_t)(micros() - deadlineUs) < 0) {
+        }
+        
+        uint32_t nowUs = micros();
+        rampStep();
+        
+        uint32_t intervalUs = nowUs - lastUs;
+        if (intervalUs < minIntervalUs) minIntervalUs = intervalUs;
+        if (intervalUs > maxIntervalUs) maxIntervalUs = intervalUs;
+        lastUs = nowUs;
+    }
+    
+    if (stats) {
+        stats->steps = count;
+        stats->elapsedUs = lastUs - startUs;
+        stats->minIntervalUs = (count > 0) ? minIntervalUs : 0;
+        stats->maxIntervalUs = maxIntervalUs;
+    }
+    return true;
+}
+
+bool ADF4351::prepareFskHz(uint64_t markHz, uint64_t spaceHz, const uint8_t *bits, uint32_t bitCount,
+                           uint32_t channelSpacingHz) {
+    _keyBits = NULL;
+    if (bits == NULL || !inRange(markHz) || !inRange(spaceHz)) {
+        return false;
+    }
+    
+    uint32_t mark[6];
+    uint32_t space[6];
+    if (!computeRegistersHz(markHz, channelSpacingHz, mark) ||
+        !computeRegistersHz(spaceHz, channelSpacingHz, space) ||
+        mark[1] != space[1] || mark[4] != space[4]) {
+        return false;
+    }
+    
+    // Idle on the space tone until the first symbol
+    uint8_t dirty = dirtyRegisters(space);
+    _outputFreqHz = spaceHz;
+    stopStreams();
+    storeRegisters(space, channelSpacingHz);
+    writeRegisters(space, dirty);
+    
+    ADF4351RegisterInfo info;
+    decodeRegisters(mark, info);
+    _keyAltFreqHz = markHz;
+    _keyAltActualHz = fromNominalHz(calcOutputFrequencyHz(info, _refFreqHz));
+    _keyWords[0] = space[0];
+    _keyWords[1] = mark[0];
+    _keyReg = 0;
+    _keyBits = bits;
+    _keyBitCount = bitCount;
+    _keyIndex = 0;
+    return true;
+}
+
+bool ADF4351::prepareOok(const uint8_t *bits, uint32_t bitCount, bool muteTillLock) {
+    _keyBits = NULL;
+    if (bits == NULL || _regValid != 0x3F) {
+        return false;
+    }
+    
+    uint32_t base = _reg[4] & ~((1UL << 5) | (1UL << 10));
+    if (muteTillLock) {
+        base |= (1UL << 10);
+    }
+    
+    // Dark until the first symbol
+    if (_reg[4] != base) {
+        _reg[4] = base;
+        writeRegister(base);
+    }
+    
+    _keyWords[0] = base;
+    _keyWords[1] = base | (1UL << 5);
+    _keyReg = 4;
+    _keyBits = bits;
+    _keyBitCount = bitCount;
+    _keyIndex = 0;
+    return true;
+}
+
+bool ADF4351::symbolStep() {
+    if (_keyBits == NULL || _keyIndex >= _keyBitCount) {
+        return false;
+    }
+    
+    uint8_t bit = (_keyBits[_keyIndex >> 3] >> (7 - (_keyIndex & 7))) & 1;
+    _keyIndex++;
+    
+    // Skip repeated symbols (every R0 write also restarts band selection)
+    uint32_t word = _keyWords[bit];
+    if (word != _reg[_keyReg]) {
+        _reg[_keyReg] = word;
+        writeRegister(word);
+        
+        // An FSK symbol change moves the output to the other tone
+        if (_keyReg == 0) {
+            uint64_t freqHz = _outputFreqHz;
+            uint64_t actualHz = _actualFreqHz;
+            _outputFreqHz = _keyAltFreqHz;
+            _actualFreqHz = _keyAltActualHz;
+            _keyAltFreqHz = freqHz;
+            _keyAltActualHz = actualHz;
+        }
+    }
+    return true;
+}
+
+bool ADF4351::runSymbols(uint32_t symbolRateHz, ADF4351RampStats *stats) {
+    if (_keyBits == NULL || symbolRateHz == 0) {
+        return false;
+    }
+    
+    uint32_t minIntervalUs = 0xFFFFFFFFUL;
+    uint32_t maxIntervalUs = 0;
+    uint32_t count = _keyBitCount - _keyIndex;
+    uint32_t startUs = micros();
+    uint32_t lastUs = startUs;
+    
+    // Deadlines from the symbol index so the fractional period does not drift
+    for (uint32_t n = 0; n < count; n++) {
+        uint32_t deadlineUs = startUs + (uint32_t)((uint64_t)(n + 1) * 1000000UL / symbolRateHz);
+        while ((int32_t)(micros() - deadlineUs) < 0) {
+        }
+        
+        uint32_t nowUs = micros();
+        symbolStep();
+        
+        uint32_t intervalUs = nowUs - lastUs;
+        if (intervalUs < minIntervalUs) minIntervalUs = intervalUs;
+        if (intervalUs > maxIntervalUs) maxIntervalUs = intervalUs;
+        lastUs = nowUs;
+    }
+    
+    if (stats) {
+        stats->steps = count;
+        stats->elapsedUs = lastUs - startUs;
+        stats->minIntervalUs = (count > 0) ? minIntervalUs : 0;
+        stats->maxIntervalUs = maxIntervalUs;
+    }
+    return true;
+}
+
+uint32_t ADF4351::getMaxSymbolRate() {
+    // One 32-bit word per symbol plus the latch delay
+    uint32_t wordNs = (uint32_t)(32000000000ULL / ADF4351_SPI_CLOCK_HZ) + ADF4351_LE_DELAY_US * 1000UL;
+    return 1000000000UL / wordNs;
+}
+
+#ifdef ADF4351_SCHEDULE
+void ADF4351::setScheduleQueue(ADF4351TimedCommand *queue, uint8_t capacity) {
+    ADF4351_LOCK();
+    _schedule = queue;
+    _scheduleCapacity = (queue != NULL) ? capacity : 0;
+    _scheduleCount = 0;
+    ADF4351_UNLOCK();
+}
+
+bool ADF4351::scheduleFrequencyHz(uint32_t timeUs, uint64_t freqHz, uint32_t channelSpacingHz) {
+    ADF4351TimedCommand cmd;
+    cmd.type = ADF4351_CMD_FREQUENCY;
+    cmd.value = freqHz;
+    cmd.channelSpacingHz = channelSpacingHz;
+    cmd.timeUs = timeUs;
+    if (!inRange(freqHz) || !computeRegistersHz(freqHz, channelSpacingHz, cmd.regs)) {
+        ADF4351_LOCK();
+        _scheduleStats.rejected++;
+        ADF4351_UNLOCK();
+        return false;
+    }
+    
+    ADF4351RegisterInfo info;
+    decodeRegisters(cmd.regs, info);
+    cmd.actualFreqHz = fromNominalHz(calcOutputFrequencyHz(info, _refFreqHz));
+    cmd.generation = _planGeneration;
+    return enqueueCommand(cmd);
+}
+
+bool ADF4351::scheduleOutputPower(uint32_t timeUs, uint8_t power) {
+    ADF4351TimedCommand cmd;
+    cmd.type = ADF4351_CMD_POWER;
+    cmd.value = (power > 3) ? 3 : power;
+    cmd.timeUs = timeUs;
+    return enqueueCommand(cmd);
+}
+
+bool ADF4351::scheduleOutputEnable(uint32_t timeUs, bool enable) {
+    ADF4351TimedCommand cmd;
+    cmd.type = ADF4351_CMD_ENABLE;
+    cmd.value = enable ? 1 : 0;
+    cmd.timeUs = timeUs;
+    return enqueueCommand(cmd);
+}
+
+bool ADF4351::enqueueCommand(const ADF4351TimedCommand &cmd) {
+    ADF4351_LOCK();
+    if (_schedule == NULL || _scheduleCount >= _scheduleCapacity) {
+        _scheduleStats.rejected++;
+        ADF4351_UNLOCK();
+        return false;
+    }
+    
+    // Move entries due no later than cmd up one slot; equal times keep
+    // the order they were scheduled in
+    uint8_t n = _scheduleCount;
+    while (n > 0 && (int32_t)(_schedule[n - 1].timeUs - cmd.timeUs) <= 0) {
+        _schedule[n] = _schedule[n - 1];
+        n--;
+    }
+    _schedule[n] = cmd;
+    _scheduleCount++;
+    ADF4351_UNLOCK();
+    return true;
+}
+
+uint8_t ADF4351::serviceSchedule() {
+    // An interrupt that preempted a register write leaves the bus alone;
+    // the write services the schedule when it ends
+    if (!claimBus()) {
+        _scheduleDeferred = true;
+        return 0;
+    }
+    
+    uint8_t fired = 0;
+    while (_scheduleCount > 0) {
+        ADF4351TimedCommand &cmd = _schedule[_scheduleCount - 1];
+        if ((int32_t)(micros() - cmd.timeUs) < 0) {
+            break;
+        }
+        
+        // A command that fails to recompute is dropped rather than retried
+        if (fireCommand(cmd)) {
+            fired++;
+        } else {
+            _scheduleStats.rejected++;
+        }
+        _scheduleCount--;
+    }
+    fired += releaseBus();
+    return fired;
+}
+
+bool ADF4351::fireCommand(ADF4351TimedCommand &cmd) {
+    uint32_t lateUs = micros() - cmd.timeUs;
+    
+    if (cmd.type == ADF4351_CMD_FREQUENCY) {
+        // Reference or charge pump changed since scheduling: slow path
+        if (cmd.generation != _planGeneration) {
+            ADF4351RegisterInfo info;
+            if (!computeRegistersHz(cmd.value, cmd.channelSpacingHz, cmd.regs)) {
+                return false;
+            }
+            decodeRegisters(cmd.regs, info);
+            cmd.actualFreqHz = fromNominalHz(calcOutputFrequencyHz(info, _refFreqHz));
+            cmd.generation = _planGeneration;
+            _scheduleStats.recomputed++;
+        }
+        
+        const uint32_t outputBits = (3UL << 3) | (1UL << 5);
+        cmd.regs[4] = (cmd.regs[4] & ~outputBits) |
+                      ((uint32_t)_outputPower << 3) | ((uint32_t)_rfOutputEnable << 5);
+        
+        trace(ADF4351_TRACE_SET_FREQUENCY, (uint32_t)(cmd.value / 1000));
+        uint8_t dirty = dirtyRegisters(cmd.regs);
+        _outputFreqHz = cmd.value;
+        stopStreams();
+        storeRegisters(cmd.regs, cmd.channelSpacingHz, cmd.actualFreqHz);
+        writeRegisters(cmd.regs, dirty);
+    } else {
+        // Output changes only touch R4, edited in place
+        uint32_t fieldMask;
+        if (cmd.type == ADF4351_CMD_POWER) {
+            setOutputPower((uint8_t)cmd.value);
+            fieldMask = 3UL << 3;
+        } else {
+            enableOutput(cmd.value != 0);
+            fieldMask = 1UL << 5;
+        }
+        if (_regValid & (1 << 4)) {
+            uint32_t outputBits = ((uint32_t)_outputPower << 3) | ((uint32_t)_rfOutputEnable << 5);
+            _reg[4] = (_reg[4] & ~fieldMask) | (outputBits & fieldMask);
+            writeRegister(_reg[4]);
+        }
+    }
+    
+    _scheduleStats.fired++;
+    _scheduleLateSumUs += lateUs;
+    if (lateUs < _scheduleStats.minLateUs) _scheduleStats.minLateUs = lateUs;
+    if (lateUs > _scheduleStats.maxLateUs) _scheduleStats.maxLateUs = lateUs;
+    return true;
+}
+
+bool ADF4351::getNextCommandTime(uint32_t &timeUs) const {
+    if (_scheduleCount == 0) {
+        return false;
+    }
+    timeUs = _schedule[_scheduleCount - 1].timeUs;
+    return true;
+}
+
+uint16_t ADF4351::runSchedule() {
+    uint16_t fired = 0;
+    uint32_t timeUs;
+    while (getNextCommandTime(timeUs)) {
+        while ((int32_t)(micros() - timeUs) < 0) {
+        }
+        fired += serviceSchedule();
+    }
+    return fired;
+}
+
+uint8_t ADF4351::getScheduledCount() const {
+    return _scheduleCount;
+}
+
+void ADF4351::getScheduleStats(ADF4351ScheduleStats &stats) const {
+    stats = _scheduleStats;
+    if (stats.fired == 0) {
+        stats.minLateUs = 0;
+    } else {
+        stats.meanLateUs = (uint32_t)(_scheduleLateSumUs / stats.fired);
+    }
+}
+
+bool ADF4351::claimBus() {
+    // Interrupts run to completion, so a write seeing the bus held is
+    // nested in the one holding it
+    if (_busBusy) {
+        return false;
+    }
+    _busBusy = true;
+    return true;
 }
 
-void ADF4351::begin(double refFreqMHz) {
-    _refFreqMHz = refFreqMHz;
+uint8_t ADF4351::releaseBus() {
+    _busBusy = false;
+    if (!_scheduleDeferred) {
+        return 0;
+    }
+    _scheduleDeferred = false;
+    return serviceSchedule();
+}
+
+void ADF4351::resetScheduleStats() {
+    _scheduleStats.fired = 0;
+    _scheduleStats.rejected = 0;
+    _scheduleStats.recomputed = 0;
+    _scheduleStats.minLateUs = 0xFFFFFFFFUL;
+    _scheduleStats.meanLateUs = 0;
+    _scheduleStats.maxLateUs = 0;
+    _scheduleLateSumUs = 0;
+}
+#endif
+
+bool ADF4351::fullSweepStep() {
+    if (!updateRegisters(_channelSpacingHz)) {
+        _sweepActive = false;
+        return false;
+    }
+    resetSweepState();
+    return true;
+}
+
+void ADF4351::stopStreams() {
+    _sweepActive = false;
+    _rampWords = NULL;
+    _keyBits = NULL;
+}
+
+void ADF4351::resetSweepState() {
+    // Nominal frequency as in toNominalHz(), keeping the remainder so steps
+    // can carry into it: nominal = (f * 1e9 + scale / 2) / scale
+    uint64_t scale = 1000000000ULL + _refCorrectionPpb;
+    uint64_t nominalNum = _outputFreqHz * 1000000000ULL + scale / 2;
+    uint64_t stepNum = (uint64_t)(_sweepStepHz < 0 ? -(int64_t)_sweepStepHz : _sweepStepHz) * 1000000000ULL;
+    _sweepNominalHz = nominalNum / scale;
+    _sweepNomRem = (uint32_t)(nominalNum % scale);
+    _sweepNomStepHz = (uint32_t)(stepNum / scale);
+    _sweepNomStepRem = (uint32_t)(stepNum % scale);
     
-    // Initialize LE pin
-    pinMode(_lePin, OUTPUT);
-    digitalWrite(_lePin, HIGH);
+    uint8_t outputDivider;
+    selectOutputDivider(_sweepNominalHz, outputDivider, _sweepDivSel);
+    uint16_t mod = (_reg[1] >> 3) & 0xFFF;
     
-    // Initialize SPI
-    SPI.begin();
-    SPI.setDataMode(SPI_MODE0);
-    SPI.setBitOrder(MSBFIRST);
+    // INT * MOD + FRAC = floor((vco * pfdDen * MOD + pfdNum / 2) / pfdNum);
+    // keep the remainder of that division so steps can carry into FRAC
+    uint64_t acc = _sweepNominalHz * outputDivider * _pfdDen * mod + _pfdNumHz / 2;
+    _sweepRem = (uint32_t)(acc % _pfdNumHz);
     
-    // Calculate PFD frequency
-    _pfdFreqMHz = _refFreqMHz * (1 + _refDoubler) / (_rCounter * (1 + _refDiv2));
+    // A step larger than the VCO range always crosses a divider boundary
+    uint64_t vcoStepHz = (uint64_t)_sweepNomStepHz * outputDivider;
+    if (vcoStepHz > 2200000000ULL) {
+        _sweepStepInt = 0xFFFF;
+        return;
+    }
+    
+    uint64_t delta = vcoStepHz * _pfdDen * mod;
+    uint64_t deltaN = delta / _pfdNumHz;
+    _sweepStepRem = (uint32_t)(delta % _pfdNumHz);
+    _sweepStepInt = (uint16_t)(deltaN / mod);
+    _sweepStepFrac = (uint16_t)(deltaN % mod);
+    
+    // 1 Hz of nominal frequency is always less than one INT step
+    uint64_t unitDelta = (uint64_t)outputDivider * _pfdDen * mod;
+    _sweepUnitRem = (uint32_t)(unitDelta % _pfdNumHz);
+    _sweepUnitFrac = (uint16_t)(unitDelta / _pfdNumHz);
+}
+
+#ifndef ADF4351_NO_FLOAT
+void ADF4351::begin(double refFreqMHz) {
+    beginHz((uint32_t)toHz(refFreqMHz));
 }
 
 void ADF4351::setReference(double refFreqMHz, uint8_t rCounter, uint8_t refDoubler, uint8_t refDiv2) {
-    _refFreqMHz = refFreqMHz;
-    _rCounter = rCounter;
-    _refDoubler = refDoubler;
-    _refDiv2 = refDiv2;
-    
-    // Recalculate PFD frequency
-    _pfdFreqMHz = _refFreqMHz * (1 + _refDoubler) / (_rCounter * (1 + _refDiv2));
+    setReferenceHz((uint32_t)toHz(refFreqMHz), rCounter, refDoubler, refDiv2);
+}
+
+bool ADF4351::setReferenceAuto(double refFreqMHz, double channelSpacingMHz, ADF4351ReferenceConfig *config) {
+    if (refFreqMHz <= 0.0 || channelSpacingMHz <= 0.0) {
+        return false;
+    }
+    return setReferenceAutoHz((uint32_t)toHz(refFreqMHz), (uint32_t)toHz(channelSpacingMHz), config);
 }
 
 bool ADF4351::setFrequency(double freqMHz, double channelSpacingMHz) {
     // Validate frequency range
-    if (freqMHz < 35.0 || freqMHz > 4400.0) {
+    if (freqMHz < 35.0 || freqMHz > 4400.0 || channelSpacingMHz <= 0.0) {
+        return false;
+    }
+    
+    return setFrequencyHz(toHz(freqMHz), (uint32_t)toHz(channelSpacingMHz));
+}
+
+bool ADF4351::beginSweep(double startMHz, double stepMHz, double channelSpacingMHz) {
+    if (startMHz < 35.0 || startMHz > 4400.0 || channelSpacingMHz <= 0.0) {
         return false;
     }
     
-    _outputFreqMHz = freqMHz;
-    return updateRegisters(channelSpacingMHz);
+    int32_t stepHz = (stepMHz < 0.0) ? -(int32_t)toHz(-stepMHz) : (int32_t)toHz(stepMHz);
+    return beginSweepHz(toHz(startMHz), stepHz, (uint32_t)toHz(channelSpacingMHz));
+}
+
+void ADF4351::requestFrequency(double freqMHz, double channelSpacingMHz) {
+    // Out-of-range values are rejected when service() applies them
+    requestFrequencyHz((freqMHz > 0.0) ? toHz(freqMHz) : 0,
+                       (channelSpacingMHz > 0.0) ? (uint32_t)toHz(channelSpacingMHz) : 0);
 }
+#endif
 
 void ADF4351::setOutputPower(uint8_t power) {
     if (power > 3) power = 3;
+    trace(ADF4351_TRACE_SET_POWER, power);
     _outputPower = power;
+    invalidateRegisters(true);
 }
 
 void ADF4351::enableOutput(bool enable) {
     _rfOutputEnable = enable ? 1 : 0;
+    trace(ADF4351_TRACE_ENABLE_OUTPUT, _rfOutputEnable);
+    invalidateRegisters(true);
 }
 
 void ADF4351::setChargePumpCurrent(uint8_t current) {
     if (current > 15) current = 15;
+    trace(ADF4351_TRACE_SET_CP_CURRENT, current);
     _chargePumpCurr = current;
+    invalidateRegisters();
+}
+
+void ADF4351::sleep() {
+    trace(ADF4351_TRACE_SLEEP, 0);
+    _sleeping = true;
+    
+    // With nothing programmed yet the first update carries the bits
+    if ((_regValid & ((1 << 2) | (1 << 4))) == ((1 << 2) | (1 << 4))) {
+        writeRegisters(_reg, (1 << 4) | (1 << 2));
+    }
+}
+
+bool ADF4351::wake(int16_t lockDetectPin, uint32_t timeoutUs) {
+    if (!_sleeping) {
+        return true;
+    }
+    
+    uint32_t startUs = micros();
+    _sleeping = false;
+    _wakeTimeUs = 0;
+    if (_regValid != 0x3F) {
+        return true;
+    }
+    
+    writeRegisters(_reg, (1 << 4) | (1 << 2) | 0x01);
+    if (lockDetectPin < 0) {
+        return true;
+    }
+    
+    // Digital lock detect (R5) drives LD high once the loop has settled
+    while (digitalRead(lockDetectPin) != HIGH) {
+        if (micros() - startUs > timeoutUs) {
+            return false;
+        }
+    }
+    _wakeTimeUs = micros() - startUs;
+    trace(ADF4351_TRACE_WAKE, _wakeTimeUs);
+    return true;
+}
+
+bool ADF4351::waitForLock(uint8_t lockDetectPin, uint32_t timeoutUs) {
+    uint32_t elapsedUs;
+    bool locked;
+    while (!(locked = (digitalRead(lockDetectPin) == HIGH)) && (micros() - _tuneUs) < timeoutUs) {
+    }
+    elapsedUs = micros() - _tuneUs;
+    recordLockTime(elapsedUs, locked);
+    return locked;
+}
+
+void ADF4351::recordLockTime(uint32_t lockUs, bool locked) {
+#ifdef ADF4351_LOCK_HISTOGRAM
+    uint8_t band = (_reg[4] >> 20) & 0x7;
+    if (band > 6) {
+        return;
+    }
+    
+    ADF4351_LOCK();
+    if (!locked) {
+        _lockAnomalous = true;
+        _lockAnomalies++;
+        ADF4351_UNLOCK();
+        return;
+    }
+    
+    uint8_t bucket = 0;
+    while (bucket < ADF4351_LOCK_BUCKETS - 1 && (lockUs >> (bucket + 1)) != 0) {
+        bucket++;
+    }
+    
+    // Judge against the band's history before adding the new sample;
+    // percentiles of a handful of samples mean nothing
+    uint16_t *hist = _lockHist[band];
+    uint32_t total = 0;
+    for (uint8_t b = 0; b < ADF4351_LOCK_BUCKETS; b++) {
+        total += hist[b];
+    }
+    bool anomalous = false;
+    if (total >= 32) {
+        uint32_t target = (total * _lockPercentile + 99) / 100;
+        uint32_t seen = 0;
+        uint8_t limit = 0;
+        while (limit < ADF4351_LOCK_BUCKETS - 1 && (seen += hist[limit]) < target) {
+            limit++;
+        }
+        anomalous = bucket > limit;
+    }
+    _lockAnomalous = anomalous;
+    if (anomalous) {
+        _lockAnomalies++;
+    }
+    
+    if (hist[bucket] == 0xFFFF) {
+        for (uint8_t b = 0; b < ADF4351_LOCK_BUCKETS; b++) {
+            hist[b] >>= 1;
+        }
+    }
+    hist[bucket]++;
+    ADF4351_UNLOCK();
+#else
+    (void)lockUs;
+    (void)locked;
+#endif
+}
+
+#ifdef ADF4351_LOCK_HISTOGRAM
+void ADF4351::setLockAnomalyPercentile(uint8_t percentile) {
+    if (percentile < 50) percentile = 50;
+    if (percentile > 99) percentile = 99;
+    _lockPercentile = percentile;
+}
+
+bool ADF4351::getLockHistogram(uint8_t band, uint16_t counts[ADF4351_LOCK_BUCKETS]) const {
+    if (band > 6) {
+        return false;
+    }
+    
+    ADF4351_LOCK();
+    for (uint8_t b = 0; b < ADF4351_LOCK_BUCKETS; b++) {
+        counts[b] = _lockHist[band][b];
+    }
+    ADF4351_UNLOCK();
+    return true;
+}
+
+uint32_t ADF4351::getLockTimePercentileUs(uint8_t band, uint8_t percentile) const {
+    uint16_t counts[ADF4351_LOCK_BUCKETS];
+    if (!getLockHistogram(band, counts)) {
+        return 0;
+    }
+    
+    uint32_t total = 0;
+    for (uint8_t b = 0; b < ADF4351_LOCK_BUCKETS; b++) {
+        total += counts[b];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    
+    uint32_t target = (total * percentile + 99) / 100;
+    uint32_t seen = 0;
+    uint8_t b = 0;
+    while (b < ADF4351_LOCK_BUCKETS - 1 && (seen += counts[b]) < target) {
+        b++;
+    }
+    return 2UL << b;
+}
+
+uint32_t ADF4351::getLockAnomalyCount() const {
+    ADF4351_LOCK();
+    uint32_t count = _lockAnomalies;
+    ADF4351_UNLOCK();
+    return count;
+}
+
+bool ADF4351::wasLastLockAnomalous() const {
+    return _lockAnomalous;
 }
 
+void ADF4351::clearLockHistogram() {
+    ADF4351_LOCK();
+    for (uint8_t band = 0; band < 7; band++) {
+        for (uint8_t b = 0; b < ADF4351_LOCK_BUCKETS; b++) {
+            _lockHist[band][b] = 0;
+        }
+    }
+    _lockAnomalous = false;
+    _lockAnomalies = 0;
+    ADF4351_UNLOCK();
+}
+#endif
+
+bool ADF4351::isSleeping() const {
+    return _sleeping;
+}
+
+uint32_t ADF4351::getWakeTimeUs() const {
+    return _wakeTimeUs;
+}
+
+uint64_t ADF4351::getFrequencyHz() const {
+    return _outputFreqHz;
+}
+
+uint64_t ADF4351::getActualFrequencyHz() const {
+    return _actualFreqHz;
+}
+
+uint32_t ADF4351::getPFDFrequencyHz() const {
+    return (_pfdNumHz + _pfdDen / 2) / _pfdDen;
+}
+
+#ifndef ADF4351_NO_FLOAT
 double ADF4351::getFrequency() const {
-    return _outputFreqMHz;
+    return _outputFreqHz / 1e6;
 }
 
 double ADF4351::getPFDFrequency() const {
-    return _pfdFreqMHz;
+    return _pfdNumHz / 1e6 / _pfdDen;
+}
+
+double ADF4351::getActualFrequency() const {
+    return _actualFreqHz / 1e6;
+}
+#endif
+
+uint32_t ADF4351::getRegister(uint8_t index) const {
+    if (index > 5) return 0;
+    return _reg[index];
+}
+
+void ADF4351::getRegisterInfo(ADF4351RegisterInfo &info) const {
+    decodeRegisters(_reg, info);
+}
+
+bool ADF4351::verifyRegisters() const {
+    if (_actualFreqHz == 0) {
+        return false;
+    }
+    
+    ADF4351RegisterInfo info;
+    decodeRegisters(_reg, info);
+    
+    if (info.rCounter != _rCounter ||
+        info.refDoubler != _refDoubler ||
+        info.refDiv2 != _refDiv2 ||
+        info.chargePumpCurrent != _chargePumpCurr ||
+        info.outputPower != _outputPower ||
+        info.rfOutputEnable != _rfOutputEnable) {
+        return false;
+    }
+    
+    uint64_t freqHz = calcOutputFrequencyHz(info, _refFreqHz);
+    if (fromNominalHz(freqHz) != _actualFreqHz) {
+        return false;
+    }
+    
+    // Quantization error must stay within half a step (MOD may be clamped
+    // so the real step can be coarser than the requested channel spacing),
+    // measured against the nominal reference
+    uint64_t stepDen = (uint64_t)_pfdDen * info.modValue * info.outputDivider;
+    uint64_t stepHz = (_pfdNumHz + stepDen - 1) / stepDen;
+    if (stepHz < _channelSpacingHz) stepHz = _channelSpacingHz;
+    uint64_t targetHz = toNominalHz(_outputFreqHz);
+    uint64_t errorHz = (freqHz > targetHz) ? freqHz - targetHz : targetHz - freqHz;
+    return errorHz <= stepHz / 2 + 1;
+}
+
+void ADF4351::invalidateRegisters(bool outputOnly) {
+    // Nothing is recomputed here: cached and hop table words are checked
+    // against the generation when used. Prepared ramps and bitstreams have
+    // no generation, so they are dropped.
+    _generation++;
+    _rampWords = NULL;
+    _keyBits = NULL;
+    if (_generation == 0) {
+        // Wrapped: make sure no old entry can match again
+        _generation = 1;
+        clearCache();
+        for (uint16_t n = 0; n < _hopCount; n++) {
+            _hopTable[n].generation = 0;
+        }
+    }
+    
+#ifdef ADF4351_SCHEDULE
+    // Scheduled commands pick up output power and enable when they fire
+    if (!outputOnly) {
+        _planGeneration++;
+        if (_planGeneration == 0) {
+            _planGeneration = 1;
+            for (uint8_t n = 0; n < _scheduleCount; n++) {
+                _schedule[n].generation = 0;
+            }
+        }
+    }
+#else
+    (void)outputOnly;
+#endif
+}
+
+void ADF4351::clearCache() {
+#if ADF4351_CACHE_SIZE > 0
+    _cacheCount = 0;
+    _cacheNext = 0;
+#endif
+}
+
+uint32_t ADF4351::getCacheHits() const {
+#if ADF4351_CACHE_SIZE > 0
+    return _cacheHits;
+#else
+    return 0;
+#endif
+}
+
+uint32_t ADF4351::getCacheMisses() const {
+#if ADF4351_CACHE_SIZE > 0
+    return _cacheMisses;
+#else
+    return 0;
+#endif
+}
+
+#ifdef ADF4351_STATS
+void ADF4351::getStats(ADF4351Stats &stats) const {
+    stats = _stats;
+    
+    // Mean values are derived from the running totals
+    stats.bytesWritten = _stats.wordsWritten * 4;
+    stats.bytesPerCall = (_stats.updateCalls > 0) ? _stats.updateWords * 4 / _stats.updateCalls : 0;
+    stats.compute.meanUs = (_stats.compute.samples > 0) ? _stats.compute.totalUs / _stats.compute.samples : 0;
+    stats.bus.meanUs = (_stats.bus.samples > 0) ? _stats.bus.totalUs / _stats.bus.samples : 0;
+}
+
+void ADF4351::resetStats() {
+    _stats = ADF4351Stats();
+    _stats.compute.minUs = 0xFFFFFFFFUL;
+    _stats.bus.minUs = 0xFFFFFFFFUL;
+}
+
+void ADF4351::recordTiming(ADF4351Timing &timing, uint32_t us) {
+    timing.samples++;
+    timing.totalUs += us;
+    if (us < timing.minUs) timing.minUs = us;
+    if (us > timing.maxUs) timing.maxUs = us;
+}
+#endif
+
+uint16_t ADF4351::getTraceCount() const {
+#if ADF4351_TRACE_SIZE > 0
+    return _traceCount;
+#else
+    return 0;
+#endif
+}
+
+bool ADF4351::getTraceEntry(uint16_t index, ADF4351TraceEntry &entry) const {
+#if ADF4351_TRACE_SIZE > 0
+    ADF4351_LOCK();
+    bool valid = index < _traceCount;
+    if (valid) {
+        uint16_t oldest = (_traceHead + ADF4351_TRACE_SIZE - _traceCount) % ADF4351_TRACE_SIZE;
+        entry = _trace[(oldest + index) % ADF4351_TRACE_SIZE];
+    }
+    ADF4351_UNLOCK();
+    return valid;
+#else
+    (void)index;
+    (void)entry;
+    return false;
+#endif
+}
+
+void ADF4351::clearTrace() {
+#if ADF4351_TRACE_SIZE > 0
+    ADF4351_LOCK();
+    _traceHead = 0;
+    _traceCount = 0;
+    ADF4351_UNLOCK();
+#endif
+}
+
+void ADF4351::dumpTrace(Print &out) const {
+    uint16_t count = getTraceCount();
+    uint8_t header[7] = { 'A', 'D', 'F', 'T', 1, (uint8_t)(count & 0xFF), (uint8_t)(count >> 8) };
+    out.write(header, sizeof(header));
+    
+    for (uint16_t n = 0; n < count; n++) {
+        ADF4351TraceEntry entry;
+        if (!getTraceEntry(n, entry)) {
+            // Ring shrank while dumping; pad so the stream stays parseable
+            entry.event = 0xFF;
+            entry.timeUs = 0;
+            entry.value = 0;
+        }
+        uint8_t bytes[9];
+        bytes[0] = entry.event;
+        for (uint8_t i = 0; i < 4; i++) {
+            bytes[1 + i] = (entry.timeUs >> (8 * i)) & 0xFF;
+            bytes[5 + i] = (entry.value >> (8 * i)) & 0xFF;
+        }
+        out.write(bytes, sizeof(bytes));
+    }
+}
+
+void ADF4351::trace(uint8_t event, uint32_t value) {
+#if ADF4351_TRACE_SIZE > 0
+    uint32_t nowUs = micros();
+    ADF4351_LOCK();
+    ADF4351TraceEntry &entry = _trace[_traceHead];
+    entry.timeUs = nowUs;
+    entry.value = value;
+    entry.event = event;
+    _traceHead = (_traceHead + 1) % ADF4351_TRACE_SIZE;
+    if (_traceCount < ADF4351_TRACE_SIZE) _traceCount++;
+    ADF4351_UNLOCK();
+#else
+    (void)event;
+    (void)value;
+#endif
+}
+
+void ADF4351::decodeRegisters(const uint32_t regs[6], ADF4351RegisterInfo &info) {
+    // R0: INT [30:15], FRAC [14:3]
+    info.intValue = (regs[0] >> 15) & 0xFFFF;
+    info.fracValue = (regs[0] >> 3) & 0xFFF;
+    
+    // R1: MOD [14:3], phase [26:15], prescaler [27]
+    info.modValue = (regs[1] >> 3) & 0xFFF;
+    info.phaseValue = (regs[1] >> 15) & 0xFFF;
+    info.prescaler = (regs[1] >> 27) & 0x1;
+    
+    // R2: power-down [5], LDP [7], LDF [8], CP current [12:9],
+    //     R counter [23:14], RDIV2 [24], doubler [25]
+    info.powerDown = (regs[2] >> 5) & 0x1;
+    info.ldp = (regs[2] >> 7) & 0x1;
+    info.ldf = (regs[2] >> 8) & 0x1;
+    info.chargePumpCurrent = (regs[2] >> 9) & 0xF;
+    info.rCounter = (regs[2] >> 14) & 0x3FF;
+    info.refDiv2 = (regs[2] >> 24) & 0x1;
+    info.refDoubler = (regs[2] >> 25) & 0x1;
+    
+    // R3: clock divider [14:3]
+    info.clockDivider = (regs[3] >> 3) & 0xFFF;
+    info.chargeCancel = (regs[3] >> 21) & 0x1;
+    info.antiBacklash = (regs[3] >> 22) & 0x1;
+    
+    // R4: power [4:3], RF enable [5], MTLD [10], VCO power-down [11],
+    //     band select clock divider [19:12], RF divider [22:20], feedback [23]
+    info.outputPower = (regs[4] >> 3) & 0x3;
+    info.rfOutputEnable = (regs[4] >> 5) & 0x1;
+    info.muteTillLock = (regs[4] >> 10) & 0x1;
+    info.vcoPowerDown = (regs[4] >> 11) & 0x1;
+    info.bandSelectClockDiv = (regs[4] >> 12) & 0xFF;
+    info.rfDividerSelect = (regs[4] >> 20) & 0x7;
+    info.outputDivider = (info.rfDividerSelect <= 6) ? (1 << info.rfDividerSelect) : 0;
+    info.feedbackSelect = (regs[4] >> 23) & 0x1;
+    
+    // R5: LD pin mode [23:22]
+    info.lockDetectPinMode = (regs[5] >> 22) & 0x3;
+}
+
+uint64_t ADF4351::calcOutputFrequencyHz(const ADF4351RegisterInfo &info, uint32_t refFreqHz) {
+    if (info.rCounter == 0 || info.modValue == 0 || info.outputDivider == 0) {
+        return 0;
+    }
+    
+    // f = (INT + FRAC / MOD) * fPFD, scaled to keep the division exact
+    uint64_t num = ((uint64_t)info.intValue * info.modValue + info.fracValue) *
+                   ((uint64_t)refFreqHz * (1 + info.refDoubler));
+    uint64_t den = (uint64_t)info.modValue * info.rCounter * (1 + info.refDiv2);
+    
+    // Fundamental feedback locks the VCO, divided feedback locks the output
+    if (info.feedbackSelect) {
+        den *= info.outputDivider;
+    }
+    return (num + den / 2) / den;
+}
+
+#ifndef ADF4351_NO_FLOAT
+double ADF4351::calcOutputFrequency(const ADF4351RegisterInfo &info, double refFreqMHz) {
+    if (info.rCounter == 0 || info.modValue == 0 || info.outputDivider == 0) {
+        return 0.0;
+    }
+    
+    double pfdFreqMHz = refFreqMHz * (1 + info.refDoubler) / (info.rCounter * (1 + info.refDiv2));
+    double N = info.intValue + (double)info.fracValue / info.modValue;
+    
+    // Fundamental feedback locks the VCO, divided feedback locks the output
+    if (info.feedbackSelect) {
+        return N * pfdFreqMHz / info.outputDivider;
+    }
+    return N * pfdFreqMHz;
+}
+
+bool ADF4351::computeRegisters(double freqMHz, double channelSpacingMHz, uint32_t regs[6]) const {
+    if (freqMHz <= 0.0 || channelSpacingMHz <= 0.0) {
+        return false;
+    }
+    return computeRegistersHz(toHz(freqMHz), (uint32_t)toHz(channelSpacingMHz), regs);
+}
+
+void ADF4351::estimateLockTime(const uint32_t fromRegs[6], const uint32_t toRegs[6],
+                               double refFreqMHz, const ADF4351LoopFilter &loop,
+                               ADF4351LockEstimate &est) {
+    ADF4351RegisterInfo from;
+    ADF4351RegisterInfo to;
+    decodeRegisters(fromRegs, from);
+    decodeRegisters(toRegs, to);
+    
+    // A retune writes R0 plus every register that changed, 32 clocks each
+    // plus the LE delay
+    uint8_t words = 1;
+    for (uint8_t i = 1; i < 6; i++) {
+        if (fromRegs[i] != toRegs[i]) words++;
+    }
+    est.writeTimeUs = words * (32.0 * 1e6 / ADF4351_SPI_CLOCK_HZ + ADF4351_LE_DELAY_US);
+    
+    // Writing R0 starts VCO band selection, clocked at fPFD / band select divider
+    double pfdFreqMHz = refFreqMHz * (1 + to.refDoubler) / (to.rCounter * (1 + to.refDiv2));
+    est.bandSelectTimeUs = 0.0;
+    if (to.bandSelectClockDiv > 0) {
+        est.bandSelectTimeUs = ADF4351_BAND_SELECT_CYCLES * to.bandSelectClockDiv / pfdFreqMHz;
+    }
+    
+    // A change of output divider moves the VCO to a different band
+    est.recalibration = (from.rfDividerSelect != to.rfDividerSelect) ||
+                        (from.modValue == 0);
+    
+    // Settling of a second-order loop: t = ln(step / tolerance) / (zeta * wn),
+    // with zeta approximated from the phase margin and wn from the bandwidth
+    double fromVcoMHz = calcOutputFrequency(from, refFreqMHz) * from.outputDivider;
+    double toVcoMHz = calcOutputFrequency(to, refFreqMHz) * to.outputDivider;
+    double stepHz = fabs(toVcoMHz - fromVcoMHz) * 1e6;
+    if (est.recalibration || fromVcoMHz == 0.0) {
+        // Start of band selection leaves the VCO anywhere in its range
+        stepHz = 2200.0e6;
+    }
+    
+    est.settleTimeUs = 0.0;
+    double zeta = loop.phaseMarginDeg / 100.0;
+    double wn = 2.0 * M_PI * loop.bandwidthKHz * 1e3;
+    if (stepHz > loop.toleranceHz && zeta > 0.0 && wn > 0.0 && loop.toleranceHz > 0.0) {
+        est.settleTimeUs = log(stepHz / loop.toleranceHz) / (zeta * wn) * 1e6;
+    }
+    
+    est.totalTimeUs = est.writeTimeUs + est.bandSelectTimeUs + est.settleTimeUs;
+}
+
+double ADF4351::planHopRate(const double *freqsMHz, uint16_t count, double channelSpacingMHz,
+                            const ADF4351LoopFilter &loop, ADF4351LockEstimate *estimates) const {
+    double worstUs;
+    double totalUs;
+    if (!walkHops(freqsMHz, count, channelSpacingMHz, loop, estimates, worstUs, totalUs) ||
+        worstUs <= 0.0) {
+        return 0.0;
+    }
+    return 1e6 / worstUs;
+}
+
+double ADF4351::predictHopTime(const double *freqsMHz, uint16_t count, double channelSpacingMHz,
+                               const ADF4351LoopFilter &loop) const {
+    double worstUs;
+    double totalUs;
+    if (!walkHops(freqsMHz, count, channelSpacingMHz, loop, NULL, worstUs, totalUs)) {
+        return 0.0;
+    }
+    return totalUs;
+}
+
+bool ADF4351::reorderHops(double *freqsMHz, uint16_t count, double channelSpacingMHz,
+                          const ADF4351LoopFilter &loop, double *beforeUs, double *afterUs) const {
+    double worstUs;
+    double totalUs;
+    if (!walkHops(freqsMHz, count, channelSpacingMHz, loop, NULL, worstUs, totalUs)) {
+        return false;
+    }
+    if (beforeUs) {
+        *beforeUs = totalUs;
+    }
+    
+    // Insertion sort by divider band, then by VCO frequency. Alternate
+    // bands run in opposite directions so the VCO step between the last
+    // hop of one band and the first of the next stays small.
+    for (uint16_t n = 1; n < count; n++) {
+        double freqMHz = freqsMHz[n];
+        uint8_t divider;
+        uint8_t divSel;
+        selectOutputDivider(toHz(freqMHz), divider, divSel);
+        double vcoMHz = (divSel & 1) ? -freqMHz * divider : freqMHz * divider;
+        
+        uint16_t m = n;
+        while (m > 0) {
+            uint8_t prevDivider;
+            uint8_t prevDivSel;
+            selectOutputDivider(toHz(freqsMHz[m - 1]), prevDivider, prevDivSel);
+            double prevVcoMHz = (prevDivSel & 1) ? -freqsMHz[m - 1] * prevDivider
+                                                 : freqsMHz[m - 1] * prevDivider;
+            if (prevDivSel < divSel || (prevDivSel == divSel && prevVcoMHz <= vcoMHz)) {
+                break;
+            }
+            freqsMHz[m] = freqsMHz[m - 1];
+            m--;
+        }
+        freqsMHz[m] = freqMHz;
+    }
+    
+    walkHops(freqsMHz, count, channelSpacingMHz, loop, NULL, worstUs, totalUs);
+    if (afterUs) {
+        *afterUs = totalUs;
+    }
+    return true;
+}
+
+bool ADF4351::walkHops(const double *freqsMHz, uint16_t count, double channelSpacingMHz,
+                       const ADF4351LoopFilter &loop, ADF4351LockEstimate *estimates,
+                       double &worstUs, double &totalUs) const {
+    uint32_t prev[6];
+    uint32_t next[6];
+    for (uint8_t i = 0; i < 6; i++) {
+        prev[i] = _reg[i];
+    }
+    
+    worstUs = 0.0;
+    totalUs = 0.0;
+    for (uint16_t n = 0; n < count; n++) {
+        if (freqsMHz[n] < 35.0 || freqsMHz[n] > 4400.0 ||
+            !computeRegisters(freqsMHz[n], channelSpacingMHz, next)) {
+            return false;
+        }
+        
+        ADF4351LockEstimate est;
+        estimateLockTime(prev, next, _refFreqHz / 1e6, loop, est);
+        if (estimates) {
+            estimates[n] = est;
+        }
+        if (est.totalTimeUs > worstUs) {
+            worstUs = est.totalTimeUs;
+        }
+        totalUs += est.totalTimeUs;
+        
+        for (uint8_t i = 0; i < 6; i++) {
+            prev[i] = next[i];
+        }
+    }
+    return true;
 }
+#endif
 
 void ADF4351::writeRegister(uint32_t data) {
+#ifdef ADF4351_SCHEDULE
+    bool claimed = claimBus();
+#endif
+    SPI.beginTransaction(SPISettings(ADF4351_SPI_CLOCK_HZ, MSBFIRST, SPI_MODE0));
+    shiftRegister(data);
+    SPI.endTransaction();
+#ifdef ADF4351_SCHEDULE
+    if (claimed) {
+        releaseBus();
+    }
+#endif
+}
+
+void ADF4351::writeRegisters(const uint32_t regs[6], uint8_t mask) {
+#ifdef ADF4351_SCHEDULE
+    bool claimed = claimBus();
+#endif
+    
+    // One transaction for the whole update, pulsing LE after each word
+    SPI.beginTransaction(SPISettings(ADF4351_SPI_CLOCK_HZ, MSBFIRST, SPI_MODE0));
+    for (int8_t i = 5; i >= 0; i--) {
+        if (mask & (1 << i)) {
+            shiftRegister(regs[i]);
+        }
+    }
+    SPI.endTransaction();
+    
+    // R0 (always last) starts the retune that waitForLock() times
+    if (mask & 0x01) {
+        _tuneUs = micros();
+    }
+#ifdef ADF4351_SCHEDULE
+    if (claimed) {
+        releaseBus();
+    }
+#endif
+}
+
+void ADF4351::shiftRegister(uint32_t data) {
+    if (_sleeping) {
+        data = powerDownWord(data);
+    }
+    ADF4351_STATS_ONLY(_stats.wordsWritten++;)
+    trace(data & 0x7, data);
+    
     digitalWrite(_lePin, LOW);
     SPI.transfer((data >> 24) & 0xFF);
     SPI.transfer((data >> 16) & 0xFF);
     SPI.transfer((data >> 8) & 0xFF);
     SPI.transfer(data & 0xFF);
     digitalWrite(_lePin, HIGH);
-    delayMicroseconds(5);
-}
-
-void ADF4351::selectOutputDivider(double freqMHz, double &outDivider, uint8_t &outRFdivSel) {
-    outDivider = 1.0;
-    outRFdivSel = 0;
-    
-    if (freqMHz >= 2200.0) {
-        outDivider = 1.0;
-        outRFdivSel = 0;
-    } else if (freqMHz >= 1100.0) {
-        outDivider = 2.0;
-        outRFdivSel = 1;
-    } else if (freqMHz >= 550.0) {
-        outDivider = 4.0;
-        outRFdivSel = 2;
-    } else if (freqMHz >= 275.0) {
-        outDivider = 8.0;
-        outRFdivSel = 3;
-    } else if (freqMHz >= 137.5) {
-        outDivider = 16.0;
-        outRFdivSel = 4;
-    } else if (freqMHz >= 68.75) {
-        outDivider = 32.0;
-        outRFdivSel = 5;
-    } else {
-        outDivider = 64.0;
-        outRFdivSel = 6;
+    delayMicroseconds(ADF4351_LE_DELAY_US);
+}
+
+uint8_t ADF4351::dirtyRegisters(const uint32_t regs[6]) const {
+    // R0 is always written: it is the write that starts the update
+    uint8_t mask = 0x01;
+    for (uint8_t i = 1; i < 6; i++) {
+        if (!(_regValid & (1 << i)) || regs[i] != _reg[i]) {
+            mask |= (1 << i);
+        }
     }
+    return mask;
 }
 
-bool ADF4351::updateRegisters(double channelSpacingMHz) {
-    // Select output divider
-    double outputDivider;
-    uint8_t RFdivSel;
-    selectOutputDivider(_outputFreqMHz, outputDivider, RFdivSel);
+bool ADF4351::updateRegisters(uint32_t channelSpacingHz, ComputeFunction compute) {
+    ADF4351_STATS_ONLY(uint32_t computeStartUs = micros();)
+    ADF4351_STATS_ONLY(_stats.updateCalls++;)
     
-    // Calculate VCO frequency
-    double vcoFreqMHz = _outputFreqMHz * outputDivider;
+    uint32_t regs[6];
+    uint8_t dirty = 0;
+    bool computed = true;
     
-    // Validate VCO frequency range (2200-4400 MHz)
-    if (vcoFreqMHz < 2200.0 || vcoFreqMHz > 4400.0) {
-        return false;
+#if ADF4351_CACHE_SIZE > 0
+    // Repeat request: reuse the memoized words and skip all the math. An
+    // entry from an older generation is recomputed into the same slot.
+    uint8_t slot = _cacheNext;
+    bool stale = false;
+    for (uint8_t n = 0; n < _cacheCount; n++) {
+        const CacheEntry &entry = _cache[n];
+        if (entry.freqHz == _outputFreqHz && entry.channelSpacingHz == channelSpacingHz) {
+            if (entry.generation != _generation) {
+                slot = n;
+                stale = true;
+                break;
+            }
+            _cacheHits++;
+            for (uint8_t i = 0; i < 6; i++) {
+                regs[i] = entry.regs[i];
+            }
+            dirty = dirtyRegisters(regs);
+            storeRegisters(regs, channelSpacingHz, entry.actualFreqHz);
+            computed = false;
+            break;
+        }
+    }
+    if (computed) {
+        _cacheMisses++;
     }
+#endif
     
-    // Calculate PLL N value
-    double N = vcoFreqMHz / _pfdFreqMHz;
-    uint16_t N_int = (uint16_t)floor(N);
+    if (computed) {
+        bool valid = compute ? compute(*this, _outputFreqHz, channelSpacingHz, regs)
+                             : computeRegistersHz(_outputFreqHz, channelSpacingHz, regs);
+        if (!valid) {
+            return false;
+        }
+        dirty = dirtyRegisters(regs);
+        storeRegisters(regs, channelSpacingHz);
+        
+#if ADF4351_CACHE_SIZE > 0
+        CacheEntry &entry = _cache[slot];
+        entry.freqHz = _outputFreqHz;
+        entry.channelSpacingHz = channelSpacingHz;
+        entry.actualFreqHz = _actualFreqHz;
+        for (uint8_t i = 0; i < 6; i++) {
+            entry.regs[i] = regs[i];
+        }
+        entry.generation = _generation;
+        if (!stale) {
+            _cacheNext = (_cacheNext + 1) % ADF4351_CACHE_SIZE;
+            if (_cacheCount < ADF4351_CACHE_SIZE) _cacheCount++;
+        }
+#endif
+    }
+    
+    ADF4351_STATS_ONLY(uint32_t busStartUs = micros();)
+    
+    writeRegisters(regs, dirty);
+    
+#ifdef ADF4351_STATS
+    for (uint8_t i = 0; i < 6; i++) {
+        _stats.updateWords += (dirty >> i) & 1;
+    }
+#endif
+    ADF4351_STATS_ONLY(recordTiming(_stats.compute, busStartUs - computeStartUs);)
+    ADF4351_STATS_ONLY(recordTiming(_stats.bus, micros() - busStartUs);)
+    
+    return true;
+}
+
+void ADF4351::storeRegisters(const uint32_t regs[6], uint32_t channelSpacingHz) {
+    ADF4351RegisterInfo info;
+    decodeRegisters(regs, info);
+    storeRegisters(regs, channelSpacingHz, fromNominalHz(calcOutputFrequencyHz(info, _refFreqHz)));
+}
+
+void ADF4351::storeRegisters(const uint32_t regs[6], uint32_t channelSpacingHz, uint64_t actualFreqHz) {
+    // Keep a copy of what was written for read-back
+    for (uint8_t i = 0; i < 6; i++) {
+        _reg[i] = regs[i];
+    }
+    _regValid = 0x3F;
+    _channelSpacingHz = channelSpacingHz;
+    _actualFreqHz = actualFreqHz;
+}
+
+bool ADF4351::computeRegistersHz(uint64_t freqHz, uint32_t channelSpacingHz, uint32_t regs[6]) const {
+    FrequencyWords w;
+    uint16_t mod = calcModulus(channelSpacingHz, _pfdNumHz, _pfdDen);
+    if (!calcFrequencyWords(toNominalHz(freqHz), mod, _pfdNumHz, _pfdDen, w)) {
+        return false;
+    }
     
-    // Calculate modulus for desired channel spacing
-    uint16_t MOD = (uint16_t)round(_pfdFreqMHz / channelSpacingMHz);
-    if (MOD > 4095) MOD = 4095;
+    buildRegisters(w, regs);
+    return true;
+}
+
+size_t ADF4351::computeRegistersHz(const uint64_t *freqsHz, size_t count, ADF4351RegisterSet *out,
+                                   uint32_t channelSpacingHz) const {
+    // The modulus is the same for every entry, so only the per-frequency
+    // words are worked out in the loop
+    uint16_t mod = calcModulus(channelSpacingHz, _pfdNumHz, _pfdDen);
     
-    // Calculate fractional value
-    uint16_t N_frac = (uint16_t)round((N - N_int) * MOD);
-    if (N_frac >= MOD) {
-        N_int += N_frac / MOD;
-        N_frac = N_frac % MOD;
+    size_t valid = 0;
+    for (size_t n = 0; n < count; n++) {
+        FrequencyWords w;
+        uint32_t *reg = out[n].reg;
+        if (!calcFrequencyWords(toNominalHz(freqsHz[n]), mod, _pfdNumHz, _pfdDen, w)) {
+            for (uint8_t i = 0; i < 6; i++) {
+                reg[i] = 0;
+            }
+            continue;
+        }
+        buildRegisters(w, reg);
+        valid++;
     }
+    return valid;
+}
+
+void ADF4351::buildRegisters(const FrequencyWords &w, uint32_t regs[6]) const {
+    uint16_t N_int = w.nInt;
+    uint16_t N_frac = w.nFrac;
+    uint16_t MOD = w.mod;
+    uint8_t RFdivSel = w.rfDivSel;
     
     // Choose prescaler
     uint8_t prescaler = (N_int < 75) ? 0 : 1;
@@ -152,8 +2140,12 @@ bool ADF4351::updateRegisters(double channelSpacingMHz) {
     uint8_t ldp = (N_frac == 0) ? 1 : 0;
     uint8_t ldf = (N_frac == 0) ? 1 : 0;
     
+    // Integer-N PFDs above 32 MHz need the 3 ns anti-backlash pulse, with
+    // charge cancellation as recommended for integer-N
+    uint8_t abp = (N_frac == 0 && _pfdNumHz > 32000000ULL * _pfdDen) ? 1 : 0;
+    
     // Feedback select (1 = divided when using output divider)
-    uint8_t feedbackSelect = (outputDivider > 1.0) ? 1 : 1;
+    uint8_t feedbackSelect = (RFdivSel > 0) ? 1 : 1;
     
     // Band select clock divider (target 125-500 kHz)
     uint16_t bandSelDiv = 200;
@@ -190,8 +2182,8 @@ bool ADF4351::updateRegisters(double channelSpacingMHz) {
     reg3 |= (150u << 3);                        // Clock divider value
     reg3 |= (0u << 15);                         // Clock divider mode
     reg3 |= (0u << 18);                         // CSR
-    reg3 |= (0u << 21);                         // Charge cancel
-    reg3 |= (0u << 22);                         // Anti-backlash
+    reg3 |= ((uint32_t)abp << 21);              // Charge cancel
+    reg3 |= ((uint32_t)abp << 22);              // Anti-backlash
     reg3 |= (0u << 23);                         // Band select clock mode
     
     // R4: Output settings
@@ -213,13 +2205,10 @@ bool ADF4351::updateRegisters(double channelSpacingMHz) {
     reg5 |= (0u << 21);                         // Reserved (must be 0)
     reg5 |= (1u << 22);                         // Lock detect mode
     
-    // Write registers (R5 to R0)
-    writeRegister(reg5);
-    writeRegister(reg4);
-    writeRegister(reg3);
-    writeRegister(reg2);
-    writeRegister(reg1);
-    writeRegister(reg0);
-    
-    return true;
+    regs[0] = reg0;
+    regs[1] = reg1;
+    regs[2] = reg2;
+    regs[3] = reg3;
+    regs[4] = reg4;
+    regs[5] = reg5;
 }
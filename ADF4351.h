@@ -20,6 +20,307 @@
 #include <Arduino.h>
 #include <SPI.h>
 
+/*
+ * Serial interface timing (ADF4351 datasheet, Table 2):
+ *   t1  LE setup time            20 ns
+ *   t2  DATA to CLK setup time   10 ns
+ *   t3  DATA to CLK hold time    10 ns
+ *   t4  CLK high duration        25 ns
+ *   t5  CLK low duration         25 ns
+ *   t6  CLK to LE setup time     10 ns
+ *   t7  LE pulse width           20 ns
+ *
+ * t4 + t5 limits SCK to 20 MHz. Both values below are used by
+ * ADF4351.cpp, so change them with build flags (see README) to tune bus
+ * throughput; extras/host/check_spi times a build against these limits.
+ */
+
+// SPI clock used for register writes (must not exceed 20 MHz)
+#ifndef ADF4351_SPI_CLOCK_HZ
+#define ADF4351_SPI_CLOCK_HZ 4000000UL
+#endif
+
+// Delay after LE rises before the next write (must cover t7)
+#ifndef ADF4351_LE_DELAY_US
+#define ADF4351_LE_DELAY_US 5
+#endif
+
+// Number of setFrequency() results to memoize (0 disables the cache)
+#ifndef ADF4351_CACHE_SIZE
+#define ADF4351_CACHE_SIZE 0
+#endif
+
+// Define ADF4351_STATS in the build flags to enable call/timing counters
+
+// Define ADF4351_LOCK_HISTOGRAM in the build flags to keep per-band lock time
+// histograms from waitForLock() and measureSweepHz()
+
+// Lock time histogram buckets: bucket b counts lock times from 2^b to 2^(b+1) us
+#define ADF4351_LOCK_BUCKETS 16
+
+// Number of entries in the event trace ring (0 disables tracing)
+#ifndef ADF4351_TRACE_SIZE
+#define ADF4351_TRACE_SIZE 0
+#endif
+
+/*
+ * Integer-only build: define ADF4351_NO_FLOAT in the build flags (it must
+ * be seen by ADF4351.cpp, not just the sketch) to drop the double-based
+ * MHz API and the lock-time model. Register calculation always uses
+ * integer arithmetic; the *Hz methods are available in both builds.
+ */
+
+/**
+ * @brief Decoded view of the six ADF4351 register words (R0-R5)
+ */
+struct ADF4351RegisterInfo {
+    // R0
+    uint16_t intValue;          // 16-bit integer value (INT)
+    uint16_t fracValue;         // 12-bit fractional value (FRAC)
+    
+    // R1
+    uint16_t modValue;          // 12-bit modulus (MOD)
+    uint16_t phaseValue;        // 12-bit phase value
+    uint8_t prescaler;          // 0 = 4/5, 1 = 8/9
+    
+    // R2
+    uint16_t rCounter;          // 10-bit R counter
+    uint8_t refDoubler;         // Reference doubler
+    uint8_t refDiv2;            // Reference divide-by-2
+    uint8_t chargePumpCurrent;  // Charge pump current setting (0-15)
+    uint8_t ldp;                // Lock detect precision
+    uint8_t ldf;                // Lock detect function
+    uint8_t powerDown;          // Power-down bit
+    
+    // R3
+    uint16_t clockDivider;      // 12-bit clock divider value
+    uint8_t chargeCancel;       // Charge cancellation
+    uint8_t antiBacklash;       // Anti-backlash pulse width (0 = 6 ns, 1 = 3 ns)
+    
+    // R4
+    uint8_t outputPower;        // RF output power (0-3)
+    uint8_t rfOutputEnable;     // RF output enable
+    uint8_t muteTillLock;       // Mute till lock detect
+    uint8_t vcoPowerDown;       // VCO power-down
+    uint8_t bandSelectClockDiv; // Band select clock divider
+    uint8_t rfDividerSelect;    // RF divider select code (0-6)
+    uint8_t outputDivider;      // RF output divider (1-64)
+    uint8_t feedbackSelect;     // 1 = fundamental, 0 = divided
+    
+    // R5
+    uint8_t lockDetectPinMode;  // LD pin mode
+};
+
+/**
+ * @brief Frequency ramp shapes for FMCW chirps
+ */
+enum ADF4351RampShape {
+    ADF4351_RAMP_SAWTOOTH,      // start -> stop, jump back to start
+    ADF4351_RAMP_TRIANGLE       // start -> stop -> start
+};
+
+/**
+ * @brief Timing measured by runRamp()
+ */
+struct ADF4351RampStats {
+    uint32_t steps;             // R0 words written
+    uint32_t elapsedUs;         // Time from first to last write
+    uint32_t minIntervalUs;     // Shortest interval between writes
+    uint32_t maxIntervalUs;     // Longest interval between writes
+};
+
+/**
+ * @brief Detector read-out used by measureSweepHz()
+ * 
+ * Typically wraps analogRead(). Called once per step after the loop has
+ * settled, with the frequency just programmed.
+ */
+typedef uint16_t (*ADF4351SampleFunction)(uint64_t freqHz);
+
+/**
+ * @brief One precomputed entry of a hop table
+ */
+struct ADF4351HopEntry {
+    uint64_t freqHz;            // Output frequency in Hz (set by the caller)
+    uint32_t regs[6];           // Register words R0-R5 (filled in by the driver)
+    uint16_t generation;        // Settings generation of regs (driver use)
+};
+
+/**
+ * @brief Programmed state saved for a warm start
+ * 
+ * Filled by saveState() and passed back to begin() after a reset. The
+ * layout has no interior padding, so it can be stored byte for byte in
+ * EEPROM or flash (e.g. EEPROM.put()/EEPROM.get()) and read back on the
+ * same target.
+ */
+struct ADF4351SavedState {
+    uint64_t outputFreqHz;      // Requested output frequency in Hz
+    uint64_t actualFreqHz;      // Synthesized output frequency in Hz
+    uint32_t regs[6];           // Register words R0-R5
+    uint32_t refFreqHz;         // Reference input frequency in Hz
+    uint32_t channelSpacingHz;  // Channel spacing in Hz
+    int32_t refCorrectionPpb;   // Reference correction in parts per billion
+    uint8_t magic[4];           // "ADFS"
+    uint8_t version;            // Layout version (2)
+    uint8_t rCounter;           // Reference settings
+    uint8_t refDoubler;
+    uint8_t refDiv2;
+    uint8_t outputPower;        // Output settings
+    uint8_t rfOutputEnable;
+    uint8_t chargePumpCurr;
+    uint8_t reserved;           // Always 0
+    uint16_t checksum;          // Fletcher-16 over all preceding bytes
+};
+
+/**
+ * @brief Reference configuration chosen by setReferenceAutoHz()
+ */
+struct ADF4351ReferenceConfig {
+    uint8_t rCounter;           // Reference divider (R counter)
+    uint8_t refDoubler;         // Reference doubler (0 or 1)
+    uint8_t refDiv2;            // Reference divide-by-2 (0 or 1)
+    bool integerN;              // Spacing is a multiple of the PFD (integer-N, PFD up to 45 MHz)
+    bool exact;                 // Spacing is an exact PFD / MOD step
+    uint16_t mod;               // Modulus for the spacing (1 in integer-N)
+    uint32_t pfdHz;             // New PFD frequency in Hz, rounded
+    uint32_t prevPfdHz;         // PFD frequency before the change in Hz, rounded
+    uint32_t bandSelectUs;      // Predicted VCO band selection time with the new PFD
+    uint32_t prevBandSelectUs;  // Predicted VCO band selection time before the change
+    uint16_t integerNCount;     // Hop table entries hit in integer-N (planReferenceHz() only)
+};
+
+/**
+ * @brief Register words computed by the batch computeRegistersHz()
+ */
+struct ADF4351RegisterSet {
+    uint32_t reg[6];            // Register words R0-R5 (all 0 if the frequency is invalid)
+};
+
+#ifdef ADF4351_SCHEDULE
+/**
+ * @brief Kinds of time-tagged command
+ */
+enum ADF4351CommandType {
+    ADF4351_CMD_FREQUENCY = 0,  // value: output frequency in Hz
+    ADF4351_CMD_POWER,          // value: power level (0-3)
+    ADF4351_CMD_ENABLE          // value: 0 or 1
+};
+
+/**
+ * @brief One entry of the command schedule (storage owned by the caller)
+ */
+struct ADF4351TimedCommand {
+    uint64_t value;             // Frequency in Hz, power level or enable
+    uint64_t actualFreqHz;      // Synthesized frequency (frequency commands)
+    uint32_t regs[6];           // Precomputed register words (frequency commands)
+    uint32_t channelSpacingHz;  // Channel spacing in Hz (frequency commands)
+    uint32_t timeUs;            // micros() time at which to apply the command
+    uint16_t generation;        // Settings generation of regs
+    uint8_t type;               // ADF4351CommandType
+};
+
+/**
+ * @brief Timing of the commands fired from the schedule
+ */
+struct ADF4351ScheduleStats {
+    uint32_t fired;             // Commands applied
+    uint32_t rejected;          // Commands refused (queue full or invalid) or dropped because recomputing failed
+    uint32_t recomputed;        // Frequency commands recomputed at fire time after a settings change
+    uint32_t minLateUs;         // Smallest delay from the tagged time to the first register write
+    uint32_t meanLateUs;        // Mean delay
+    uint32_t maxLateUs;         // Largest delay
+};
+#endif
+
+#ifdef ADF4351_STATS
+/**
+ * @brief Min/mean/max of a timed section in microseconds
+ */
+struct ADF4351Timing {
+    uint32_t samples;           // Number of timed calls
+    uint32_t minUs;             // Shortest call
+    uint32_t meanUs;            // Mean (filled in by getStats())
+    uint32_t maxUs;             // Longest call
+    uint32_t totalUs;           // Sum of all calls
+};
+
+/**
+ * @brief Driver instrumentation counters (ADF4351_STATS builds only)
+ */
+struct ADF4351Stats {
+    uint32_t setFrequencyCalls; // setFrequency()/setFrequencyHz() calls
+    uint32_t updateCalls;       // Full register updates
+    uint32_t wordsWritten;      // 32-bit SPI words written (all paths)
+    uint32_t updateWords;       // 32-bit SPI words written by full updates
+    uint32_t bytesWritten;      // SPI bytes written (filled in by getStats())
+    uint32_t bytesPerCall;      // Mean bytes per full update (filled in by getStats())
+    ADF4351Timing compute;      // Register calculation or cache lookup per update
+    ADF4351Timing bus;          // SPI writes per update
+};
+#endif
+
+/**
+ * @brief Event types recorded in the trace ring
+ * 
+ * Values 0-5 are register writes (the register number); the rest are
+ * API calls. The value stored with each event is listed alongside.
+ */
+enum ADF4351TraceEvent {
+    ADF4351_TRACE_R0 = 0,               // Register word
+    ADF4351_TRACE_R1,
+    ADF4351_TRACE_R2,
+    ADF4351_TRACE_R3,
+    ADF4351_TRACE_R4,
+    ADF4351_TRACE_R5,
+    ADF4351_TRACE_BEGIN = 0x10,         // Reference frequency in Hz
+    ADF4351_TRACE_SET_REFERENCE,        // Reference frequency in Hz
+    ADF4351_TRACE_SET_FREQUENCY,        // Output frequency in kHz
+    ADF4351_TRACE_SET_POWER,            // Power level
+    ADF4351_TRACE_ENABLE_OUTPUT,        // 0 or 1
+    ADF4351_TRACE_SET_CP_CURRENT,       // Charge pump current setting
+    ADF4351_TRACE_SWEEP_STEP,           // Output frequency in kHz
+    ADF4351_TRACE_PREPARE_RAMP,         // Number of steps
+    ADF4351_TRACE_SLEEP,                // 0
+    ADF4351_TRACE_WAKE,                 // Wake-to-lock time in microseconds
+    ADF4351_TRACE_SET_CORRECTION        // Reference correction in ppb (signed)
+};
+
+/**
+ * @brief One entry of the trace ring
+ */
+struct ADF4351TraceEntry {
+    uint32_t timeUs;            // micros() when recorded
+    uint32_t value;             // Register word or call argument
+    uint8_t event;              // ADF4351TraceEvent
+};
+
+#ifndef ADF4351_NO_FLOAT
+/**
+ * @brief Loop filter parameters used by the lock-time model
+ */
+struct ADF4351LoopFilter {
+    double bandwidthKHz;        // Closed-loop bandwidth in kHz
+    double phaseMarginDeg;      // Phase margin in degrees
+    double toleranceHz;         // Frequency error at which the loop counts as settled
+};
+
+/**
+ * @brief Predicted cost of moving from one register set to another
+ */
+struct ADF4351LockEstimate {
+    double writeTimeUs;         // SPI time to program the registers
+    double bandSelectTimeUs;    // VCO band selection time
+    double settleTimeUs;        // PLL settling time after band selection
+    double totalTimeUs;         // Sum of the above
+    bool recalibration;         // Output divider band changed (full VCO recalibration)
+};
+
+#endif // ADF4351_NO_FLOAT
+
+// VCO band selection takes about this many band select clock cycles
+#define ADF4351_BAND_SELECT_CYCLES 10
+
 class ADF4351 {
 public:
     /**
@@ -28,6 +329,397 @@ public:
      */
     ADF4351(uint8_t lePin);
     
+    /**
+     * @brief Initialize the ADF4351 with default settings
+     * @param refFreqHz Reference frequency in Hz (default 25 MHz)
+     */
+    void beginHz(uint32_t refFreqHz = 25000000UL);
+    
+    /**
+     * @brief Initialize the ADF4351 and restore a saved state
+     * 
+     * Programs the saved register words directly, without recalculating
+     * them, so the output comes up on the last frequency as fast as the
+     * six words can be written.
+     * 
+     * @param state State from saveState(), e.g. read back from EEPROM
+     * @return true if restored, false if the state is invalid (nothing is written)
+     */
+    bool begin(const ADF4351SavedState &state);
+    
+    /**
+     * @brief Capture the programmed state for a later warm start
+     * @param state Structure to receive the state and its checksum
+     * @return true if saved, false if no frequency has been programmed yet
+     */
+    bool saveState(ADF4351SavedState &state) const;
+    
+    /**
+     * @brief Set the output frequency
+     * @param freqHz Desired output frequency in Hz (35 MHz - 4.4 GHz)
+     * @param channelSpacingHz Frequency step/channel spacing in Hz (default 10 kHz)
+     * @return true if frequency was set successfully, false otherwise
+     */
+    bool setFrequencyHz(uint64_t freqHz, uint32_t channelSpacingHz = 10000UL);
+    
+    /**
+     * @brief Start a linear sweep at a frequency
+     * 
+     * Programs the start frequency with a full register update. Each
+     * nextSweepStep() then advances by stepHz, updating INT/FRAC with an
+     * integer add-and-carry while the output divider stays the same.
+     * 
+     * @param startHz Start frequency in Hz (35 MHz - 4.4 GHz)
+     * @param stepHz Step size in Hz (negative for a downward sweep)
+     * @param channelSpacingHz Frequency step/channel spacing in Hz (default 10 kHz)
+     * @return true if the start frequency was set successfully
+     */
+    bool beginSweepHz(uint64_t startHz, int32_t stepHz, uint32_t channelSpacingHz = 10000UL);
+    
+    /**
+     * @brief Advance a sweep started with beginSweepHz() by one step
+     * @return true if the next frequency was set, false at the end of the range
+     */
+    bool nextSweepStep();
+    
+    /**
+     * @brief Sweep and sample a detector at each step
+     * 
+     * Each step retunes, waits for lock and calls sample(). The registers
+     * for the next step are calculated while the current one settles, so
+     * the calculation costs no time in the step period.
+     * 
+     * With a lock detect pin the sample is taken as soon as LD reads high
+     * after minDwellUs, or after maxDwellUs if it never does. Without
+     * one, every step dwells for maxDwellUs.
+     * 
+     * @param startHz Start frequency in Hz (35 MHz - 4.4 GHz)
+     * @param stepHz Step size in Hz (negative for a downward sweep)
+     * @param count Number of steps
+     * @param results Caller-owned array of count entries to receive the samples
+     * @param sample Detector read-out
+     * @param lockDetectPin Pin wired to the LD output, or -1 to dwell for a fixed time
+     * @param minDwellUs Time after each retune before LD is trusted
+     * @param maxDwellUs Longest wait for lock before sampling anyway
+     * @param channelSpacingHz Frequency step/channel spacing in Hz (default 10 kHz)
+     * @param stats Optional structure to receive the achieved step timing
+     * @return Number of steps sampled in lock (all sampled steps without an LD pin)
+     */
+    uint16_t measureSweepHz(uint64_t startHz, int32_t stepHz, uint16_t count, uint16_t *results,
+                            ADF4351SampleFunction sample, int16_t lockDetectPin = -1,
+                            uint32_t minDwellUs = 10, uint32_t maxDwellUs = 1000,
+                            uint32_t channelSpacingHz = 10000UL, ADF4351RampStats *stats = NULL);
+    
+    /**
+     * @brief Queue a frequency change to be applied by service()
+     * 
+     * Only the latest request is kept: if several arrive before service()
+     * runs, the earlier ones are dropped. Safe to call from an interrupt.
+     * 
+     * @param freqHz Desired output frequency in Hz (35 MHz - 4.4 GHz)
+     * @param channelSpacingHz Frequency step/channel spacing in Hz (default 10 kHz)
+     */
+    void requestFrequencyHz(uint64_t freqHz, uint32_t channelSpacingHz = 10000UL);
+    
+    /**
+     * @brief Apply the pending frequency request, if any
+     * 
+     * Call from the main loop.
+     * 
+     * @return true if a request was applied successfully
+     */
+    bool service();
+    
+    /**
+     * @brief Get the number of requests replaced by a newer one before being applied
+     * @return Coalesced request count
+     */
+    uint32_t getCoalescedRequests() const;
+    
+    /**
+     * @brief Precompute the registers for a table of hop frequencies
+     * 
+     * The caller fills in freqHz for each entry; the driver computes the
+     * register words so that hopTo() needs no arithmetic. The table stays
+     * owned by the caller and must outlive its use. After a change to the
+     * reference, its correction, output power, output enable or charge
+     * pump current, each entry is recomputed the next time it is used.
+     * 
+     * @param table Hop entries
+     * @param count Number of entries
+     * @param channelSpacingHz Frequency step/channel spacing in Hz (default 10 kHz)
+     * @return true if every frequency is valid (the table is unusable otherwise)
+     */
+    bool setHopTable(ADF4351HopEntry *table, uint16_t count, uint32_t channelSpacingHz = 10000UL);
+    
+    /**
+     * @brief Retune to a hop table entry
+     * 
+     * Writes the registers that differ from the current state, R0 last,
+     * in a single SPI transaction.
+     * 
+     * @param index Entry index
+     * @return false if index is out of range or no table is set
+     */
+    bool hopTo(uint16_t index);
+    
+    /**
+     * @brief Precompute an FMCW ramp and program its start frequency
+     * 
+     * Fills buffer with the R0 word for each of the steps frequencies from
+     * startHz to stopHz. All steps must share R1 and R4 (same output divider
+     * band and prescaler) so that only R0 needs writing during the ramp.
+     * 
+     * @param startHz Ramp start frequency in Hz
+     * @param stopHz Ramp stop frequency in Hz
+     * @param steps Number of frequencies in the ramp (at least 2)
+     * @param buffer Caller-owned array of steps entries to receive the R0 words
+     * @param shape Sawtooth or triangle
+     * @param channelSpacingHz Frequency step/channel spacing in Hz (default 10 kHz)
+     * @return true if the ramp fits in one divider band and was programmed
+     */
+    bool prepareRampHz(uint64_t startHz, uint64_t stopHz, uint16_t steps, uint32_t *buffer,
+                       ADF4351RampShape shape = ADF4351_RAMP_SAWTOOTH,
+                       uint32_t channelSpacingHz = 10000UL);
+    
+    /**
+     * @brief Write the next R0 word of the prepared ramp
+     * 
+     * A single 32-bit write with no arithmetic, suitable for calling from
+     * a timer callback.
+     */
+    void rampStep();
+    
+    /**
+     * @brief Step the prepared ramp at a fixed period, paced by micros()
+     * @param stepPeriodUs Time between R0 writes in microseconds
+     * @param count Number of steps to write
+     * @param stats Optional structure to receive the achieved timing
+     * @return false if no ramp is prepared
+     */
+    bool runRamp(uint32_t stepPeriodUs, uint32_t count, ADF4351RampStats *stats = NULL);
+    
+    /**
+     * @brief Precompute the R0 words for two-tone FSK and program the space frequency
+     * 
+     * Mark and space must share R1 and R4 (same output divider band and
+     * prescaler) so that each symbol is a single R0 write. Any retune or
+     * settings change ends the bitstream, since the words would be stale.
+     * 
+     * @param markHz Frequency sent for 1 bits in Hz
+     * @param spaceHz Frequency sent for 0 bits in Hz
+     * @param bits Caller-owned bitstream, most significant bit of bits[0] first
+     * @param bitCount Number of bits to send
+     * @param channelSpacingHz Frequency step/channel spacing in Hz (default 10 kHz)
+     * @return true if both tones fit in one divider band and the space tone was programmed
+     */
+    bool prepareFskHz(uint64_t markHz, uint64_t spaceHz, const uint8_t *bits, uint32_t bitCount,
+                      uint32_t channelSpacingHz = 10000UL);
+    
+    /**
+     * @brief Precompute the R4 words for on-off keying of the programmed frequency
+     * 
+     * 1 bits enable the RF output and 0 bits disable it, so each symbol is
+     * a single R4 write. The output is turned off until the first symbol.
+     * Replaces any prepared FSK bitstream. The next frequency or settings
+     * change ends the bitstream and restores R4 from enableOutput().
+     * 
+     * @param bits Caller-owned bitstream, most significant bit of bits[0] first
+     * @param bitCount Number of bits to send
+     * @param muteTillLock Also set mute-till-lock-detect, so 1 bits stay dark while unlocked
+     * @return false if no frequency has been programmed
+     */
+    bool prepareOok(const uint8_t *bits, uint32_t bitCount, bool muteTillLock = false);
+    
+    /**
+     * @brief Send the next symbol of the prepared FSK or OOK bitstream
+     * 
+     * Writes R0 (FSK) or R4 (OOK) only, and only when the symbol changes;
+     * suitable for calling from a timer callback at the symbol rate. With
+     * FSK, getFrequencyHz() and getActualFrequencyHz() follow the tone sent.
+     * 
+     * @return false once every bit has been sent (nothing is written)
+     */
+    bool symbolStep();
+    
+    /**
+     * @brief Send the prepared bitstream at a fixed symbol rate, paced by micros()
+     * @param symbolRateHz Symbols per second
+     * @param stats Optional structure to receive the achieved timing
+     * @return false if no bitstream is prepared or the rate is 0
+     */
+    bool runSymbols(uint32_t symbolRateHz, ADF4351RampStats *stats = NULL);
+    
+    /**
+     * @brief Get the highest symbol rate the SPI transport can sustain
+     * @return Symbols per second for one register write per symbol at ADF4351_SPI_CLOCK_HZ and ADF4351_LE_DELAY_US
+     */
+    static uint32_t getMaxSymbolRate();
+    
+#ifdef ADF4351_SCHEDULE
+    /**
+     * @brief Provide the storage for the command schedule
+     * 
+     * Any previously scheduled commands are discarded. Times are compared
+     * with wrap-around, so all pending commands must lie within about 35
+     * minutes of each other and of micros().
+     * 
+     * @param queue Caller-owned array of capacity entries
+     * @param capacity Maximum number of pending commands
+     */
+    void setScheduleQueue(ADF4351TimedCommand *queue, uint8_t capacity);
+    
+    /**
+     * @brief Schedule a frequency change at a given time
+     * 
+     * The register words are computed now, so firing only writes them.
+     * Output power and enable are taken from the chip when the command
+     * fires; other settings changes in between make it recompute. A command
+     * that can no longer be synthesized then is dropped and counted as
+     * rejected.
+     * 
+     * @param timeUs micros() time at which to retune
+     * @param freqHz Output frequency in Hz (35 MHz - 4.4 GHz)
+     * @param channelSpacingHz Frequency step/channel spacing in Hz (default 10 kHz)
+     * @return false if the frequency is invalid or the queue is full
+     */
+    bool scheduleFrequencyHz(uint32_t timeUs, uint64_t freqHz, uint32_t channelSpacingHz = 10000UL);
+    
+    /**
+     * @brief Schedule an output power change at a given time
+     * @param timeUs micros() time at which to apply it
+     * @param power Power level (0-3)
+     * @return false if the queue is full
+     */
+    bool scheduleOutputPower(uint32_t timeUs, uint8_t power);
+    
+    /**
+     * @brief Schedule enabling or disabling the RF output at a given time
+     * @param timeUs micros() time at which to apply it
+     * @param enable true to enable, false to disable
+     * @return false if the queue is full
+     */
+    bool scheduleOutputEnable(uint32_t timeUs, bool enable);
+    
+    /**
+     * @brief Apply every scheduled command whose time has come
+     * 
+     * Call from a timer interrupt armed for getNextCommandTime(), or from
+     * the main loop. Each command is one register write burst.
+     * 
+     * An interrupt that arrives while the main loop is writing registers
+     * does not touch the bus: it returns 0 and the due commands are applied
+     * as soon as that write ends. Only the bus is guarded. Frequency and
+     * settings calls update the shadow registers before writing them, so
+     * while commands are pending make those calls with the timer interrupt
+     * masked, or schedule them instead.
+     * 
+     * @return Number of commands applied (0 if deferred)
+     */
+    uint8_t serviceSchedule();
+    
+    /**
+     * @brief Get the time of the earliest pending command
+     * @param timeUs Receives the micros() time of the next command
+     * @return false if nothing is scheduled
+     */
+    bool getNextCommandTime(uint32_t &timeUs) const;
+    
+    /**
+     * @brief Apply every pending command at its time, busy-waiting on micros()
+     * @return Number of commands applied
+     */
+    uint16_t runSchedule();
+    
+    /**
+     * @brief Get the number of pending commands
+     * @return Commands waiting in the schedule
+     */
+    uint8_t getScheduledCount() const;
+    
+    /**
+     * @brief Get the scheduling error statistics
+     * @param stats Structure to receive the statistics
+     */
+    void getScheduleStats(ADF4351ScheduleStats &stats) const;
+    
+    /**
+     * @brief Reset the scheduling error statistics
+     */
+    void resetScheduleStats();
+#endif
+    
+    /**
+     * @brief Set reference frequency configuration
+     * @param refFreqHz Reference input frequency in Hz
+     * @param rCounter Reference divider (R counter)
+     * @param refDoubler Enable reference doubler (0 or 1)
+     * @param refDiv2 Enable reference divide-by-2 (0 or 1)
+     */
+    void setReferenceHz(uint32_t refFreqHz, uint8_t rCounter = 1, uint8_t refDoubler = 0, uint8_t refDiv2 = 0);
+    
+    /**
+     * @brief Correct the frequency plan for a reference oscillator offset
+     * 
+     * Each target frequency is scaled by 1e9 / (1e9 + ppb) before the
+     * nominal register arithmetic. The programmed frequency is rewritten
+     * at once; cached and hop table words are recomputed when next used.
+     * 
+     * @param ppb Reference error in parts per billion, positive if the reference runs fast (+/-1000000 max)
+     * @return false if out of range, or if the programmed frequency cannot be
+     *         synthesized with the correction (nothing changed)
+     */
+    bool setReferenceCorrectionPpb(int32_t ppb);
+    
+    /**
+     * @brief Get the reference correction
+     * @return Reference error in parts per billion
+     */
+    int32_t getReferenceCorrectionPpb() const;
+    
+    /**
+     * @brief Choose the R counter, doubler and divide-by-2 for the highest legal PFD
+     * 
+     * Picks the highest PFD that keeps MOD <= 4095 for the spacing and stays
+     * within 32 MHz (fractional-N) or 45 MHz (integer-N, when the spacing is
+     * a multiple of the PFD), preferring configurations that hit the spacing
+     * exactly. The doubler is only used with references up to 30 MHz. A
+     * programmed frequency is rewritten with the new settings.
+     * 
+     * Integer-N above 32 MHz switches R3 to the 3 ns anti-backlash pulse
+     * with charge cancellation. The 45 MHz limit keeps N at 80 or more above
+     * a 3.6 GHz VCO, so the 8/9 prescaler covers the whole range.
+     * 
+     * @param refFreqHz Reference input frequency in Hz
+     * @param channelSpacingHz Required frequency step in Hz (default 10 kHz)
+     * @param config Optional structure to receive the chosen configuration
+     * @return true if a configuration was applied, false if none is legal or the
+     *         programmed frequency cannot be synthesized with it (nothing changed)
+     */
+    bool setReferenceAutoHz(uint32_t refFreqHz, uint32_t channelSpacingHz = 10000UL,
+                            ADF4351ReferenceConfig *config = NULL);
+    
+    /**
+     * @brief Choose the reference configuration for a channel plan and load it as a hop table
+     * 
+     * Searches R = 1-255, the doubler and the divide-by-2 for the
+     * configuration that puts the most entries on an integer N (FRAC = 0),
+     * then the highest PFD. The PFD may go up to 45 MHz when every entry is
+     * integer-N, and otherwise stays within 32 MHz with MOD <= 4095 for the
+     * spacing. The configuration is applied and the table passed to
+     * setHopTable().
+     * 
+     * @param refFreqHz Reference input frequency in Hz
+     * @param table Hop entries with freqHz filled in; regs are filled by the call
+     * @param count Number of entries
+     * @param channelSpacingHz Frequency step for entries that need fractional-N (default 10 kHz)
+     * @param config Optional structure to receive the chosen configuration
+     * @return true if a configuration was applied and the hop table loaded
+     */
+    bool planReferenceHz(uint32_t refFreqHz, ADF4351HopEntry *table, uint16_t count,
+                         uint32_t channelSpacingHz = 10000UL, ADF4351ReferenceConfig *config = NULL);
+    
+#ifndef ADF4351_NO_FLOAT
     /**
      * @brief Initialize the ADF4351 with default settings
      * @param refFreqMHz Reference frequency in MHz (default 25.0 MHz)
@@ -51,6 +743,34 @@ public:
      */
     void setReference(double refFreqMHz, uint8_t rCounter = 1, uint8_t refDoubler = 0, uint8_t refDiv2 = 0);
     
+    /**
+     * @brief Choose the R counter, doubler and divide-by-2 for the highest legal PFD
+     * @param refFreqMHz Reference input frequency in MHz
+     * @param channelSpacingMHz Required frequency step in MHz (default 0.01 MHz = 10 kHz)
+     * @param config Optional structure to receive the chosen configuration
+     * @return true if a configuration was applied, false if none is legal or the
+     *         programmed frequency cannot be synthesized with it (nothing changed)
+     */
+    bool setReferenceAuto(double refFreqMHz, double channelSpacingMHz = 0.01,
+                          ADF4351ReferenceConfig *config = NULL);
+    
+    /**
+     * @brief Start a linear sweep at a frequency
+     * @param startMHz Start frequency in MHz (35 - 4400 MHz)
+     * @param stepMHz Step size in MHz (negative for a downward sweep)
+     * @param channelSpacingMHz Frequency step/channel spacing in MHz (default 0.01 MHz = 10 kHz)
+     * @return true if the start frequency was set successfully
+     */
+    bool beginSweep(double startMHz, double stepMHz, double channelSpacingMHz = 0.01);
+    
+    /**
+     * @brief Queue a frequency change to be applied by service()
+     * @param freqMHz Desired output frequency in MHz (35 - 4400 MHz)
+     * @param channelSpacingMHz Frequency step/channel spacing in MHz (default 0.01 MHz = 10 kHz)
+     */
+    void requestFrequency(double freqMHz, double channelSpacingMHz = 0.01);
+#endif
+    
     /**
      * @brief Set RF output power level
      * @param power Power level (0-3, where 3 is maximum)
@@ -69,6 +789,57 @@ public:
      */
     void setChargePumpCurrent(uint8_t current);
     
+    /**
+     * @brief Power down the synthesizer, keeping the programmed state
+     * 
+     * Sets the R2 power-down and R4 VCO power-down bits. The shadow
+     * registers keep the awake values, and frequency or settings changes
+     * made while asleep are loaded with the power-down bits still set.
+     */
+    void sleep();
+    
+    /**
+     * @brief Power up after sleep() on the programmed frequency
+     * 
+     * Rewrites R4, R2 and R0 only; the R0 write restarts VCO band selection.
+     * 
+     * @param lockDetectPin Pin wired to the LD output, or -1 to return without waiting
+     * @param timeoutUs Maximum time to wait for lock in microseconds
+     * @return true if awake and, when waiting, locked within the timeout
+     */
+    bool wake(int16_t lockDetectPin = -1, uint32_t timeoutUs = 1000);
+    
+    /**
+     * @brief Check whether the synthesizer is powered down by sleep()
+     * @return true between sleep() and wake()
+     */
+    bool isSleeping() const;
+    
+    /**
+     * @brief Get the time the last wake() took to lock
+     * @return Microseconds from the first wake() write to LD high, or 0 if not measured
+     */
+    uint32_t getWakeTimeUs() const;
+    
+    /**
+     * @brief Get the currently set output frequency
+     * @return Current output frequency in Hz
+     */
+    uint64_t getFrequencyHz() const;
+    
+    /**
+     * @brief Get the frequency actually synthesized by the last register write
+     * @return Synthesized output frequency in Hz, rounded (0 if nothing written yet)
+     */
+    uint64_t getActualFrequencyHz() const;
+    
+    /**
+     * @brief Get the calculated PFD frequency
+     * @return Phase detector frequency in Hz, rounded
+     */
+    uint32_t getPFDFrequencyHz() const;
+    
+#ifndef ADF4351_NO_FLOAT
     /**
      * @brief Get the currently set output frequency
      * @return Current output frequency in MHz
@@ -80,12 +851,546 @@ public:
      * @return Phase detector frequency in MHz
      */
     double getPFDFrequency() const;
+    
+    /**
+     * @brief Get the frequency actually synthesized by the last register write
+     * 
+     * Differs from getFrequency() by the INT/FRAC/MOD quantization error.
+     * 
+     * @return Synthesized output frequency in MHz (0 if nothing written yet)
+     */
+    double getActualFrequency() const;
+#endif
+    
+    /**
+     * @brief Get the last value written to a register
+     * @param index Register number (0-5)
+     * @return 32-bit register word, or 0 if index is out of range
+     */
+    uint32_t getRegister(uint8_t index) const;
+    
+    /**
+     * @brief Decode the last written register words
+     * @param info Structure to receive the decoded fields
+     */
+    void getRegisterInfo(ADF4351RegisterInfo &info) const;
+    
+    /**
+     * @brief Check that the written registers reproduce the driver settings
+     * 
+     * Decodes the register words and verifies that they match the reference,
+     * power and charge pump settings and that the synthesized frequency is
+     * within half a channel of the requested frequency.
+     * 
+     * @return true if the registers round-trip, false otherwise
+     */
+    bool verifyRegisters() const;
+    
+    /**
+     * @brief Discard all memoized register sets
+     * 
+     * Called automatically when the reference, output power, output enable
+     * or charge pump current change. Only has an effect when
+     * ADF4351_CACHE_SIZE is non-zero.
+     */
+    void clearCache();
+    
+    /**
+     * @brief Get the number of setFrequency() calls served from the cache
+     * @return Cache hit count (always 0 when the cache is disabled)
+     */
+    uint32_t getCacheHits() const;
+    
+    /**
+     * @brief Get the number of setFrequency() calls that had to compute registers
+     * @return Cache miss count (always 0 when the cache is disabled)
+     */
+    uint32_t getCacheMisses() const;
+    
+#ifdef ADF4351_STATS
+    /**
+     * @brief Read the instrumentation counters
+     * @param stats Structure to receive the counters
+     */
+    void getStats(ADF4351Stats &stats) const;
+    
+    /**
+     * @brief Reset the instrumentation counters
+     */
+    void resetStats();
+#endif
+    
+    /**
+     * @brief Wait for the loop to lock after the last retune
+     * 
+     * Polls the LD output (R5 selects digital lock detect). The time is
+     * measured from the end of the last register burst that wrote R0 and,
+     * in ADF4351_LOCK_HISTOGRAM builds, recorded for the current output
+     * divider band.
+     * 
+     * @param lockDetectPin Pin wired to the LD output
+     * @param timeoutUs Maximum time since the retune to wait in microseconds
+     * @return true if locked within the timeout
+     */
+    bool waitForLock(uint8_t lockDetectPin, uint32_t timeoutUs = 1000);
+    
+#ifdef ADF4351_LOCK_HISTOGRAM
+    /**
+     * @brief Set the percentile above which a lock time counts as anomalous
+     * @param percentile Percentile of the band's histogram (50-99, default 99)
+     */
+    void setLockAnomalyPercentile(uint8_t percentile);
+    
+    /**
+     * @brief Copy the lock time histogram of one output divider band
+     * 
+     * Safe to call while hops are being recorded from an interrupt.
+     * 
+     * @param band Output divider select (0-6, divider 2^band)
+     * @param counts Array to receive the bucket counts
+     * @return false if band is out of range
+     */
+    bool getLockHistogram(uint8_t band, uint16_t counts[ADF4351_LOCK_BUCKETS]) const;
+    
+    /**
+     * @brief Get a lock time percentile of one output divider band
+     * @param band Output divider select (0-6)
+     * @param percentile Percentile (1-100)
+     * @return Upper edge of the bucket holding the percentile in microseconds, or 0 with no samples
+     */
+    uint32_t getLockTimePercentileUs(uint8_t band, uint8_t percentile) const;
+    
+    /**
+     * @brief Get the number of anomalous locks (above the percentile, or timed out)
+     * @return Anomaly count
+     */
+    uint32_t getLockAnomalyCount() const;
+    
+    /**
+     * @brief Check whether the most recent recorded lock was anomalous
+     * @return true if it was above the percentile or timed out
+     */
+    bool wasLastLockAnomalous() const;
+    
+    /**
+     * @brief Clear the histograms and the anomaly count
+     */
+    void clearLockHistogram();
+#endif
+    
+    /**
+     * @brief Get the number of entries held in the trace ring
+     * @return Entry count (always 0 when ADF4351_TRACE_SIZE is 0)
+     */
+    uint16_t getTraceCount() const;
+    
+    /**
+     * @brief Read a trace entry
+     * @param index Entry index, 0 being the oldest
+     * @param entry Structure to receive the entry
+     * @return false if index is out of range
+     */
+    bool getTraceEntry(uint16_t index, ADF4351TraceEntry &entry) const;
+    
+    /**
+     * @brief Discard all trace entries
+     */
+    void clearTrace();
+    
+    /**
+     * @brief Write the trace ring in compact binary form, oldest first
+     * 
+     * Format: "ADFT", a version byte (1), a little-endian uint16 entry
+     * count, then 9 bytes per entry: event, timeUs and value (both
+     * little-endian uint32). Decode it with extras/adf4351_trace.py.
+     * 
+     * @param out Destination, e.g. Serial
+     */
+    void dumpTrace(Print &out) const;
+    
+    /**
+     * @brief Decode six register words into their fields
+     * @param regs Register words indexed by register number (R0-R5)
+     * @param info Structure to receive the decoded fields
+     */
+    static void decodeRegisters(const uint32_t regs[6], ADF4351RegisterInfo &info);
+    
+    /**
+     * @brief Calculate the output frequency described by decoded registers
+     * @param info Decoded register fields
+     * @param refFreqHz Reference input frequency in Hz
+     * @return Output frequency in Hz, rounded (0 if the fields are invalid)
+     */
+    static uint64_t calcOutputFrequencyHz(const ADF4351RegisterInfo &info, uint32_t refFreqHz);
+    
+    /**
+     * @brief Calculate register words for a frequency without writing them
+     * @param freqHz Output frequency in Hz
+     * @param channelSpacingHz Frequency step in Hz
+     * @param regs Array to receive the register words (indexed R0-R5)
+     * @return true if the frequency can be synthesized
+     */
+    bool computeRegistersHz(uint64_t freqHz, uint32_t channelSpacingHz, uint32_t regs[6]) const;
+    
+    /**
+     * @brief Calculate register words for many frequencies
+     * 
+     * Same results as calling computeRegistersHz() per frequency, with the
+     * modulus worked out once for the whole batch.
+     * 
+     * @param freqsHz Output frequencies in Hz
+     * @param count Number of frequencies
+     * @param out Array of count entries to receive the register words
+     * @param channelSpacingHz Frequency step in Hz (default 10 kHz)
+     * @return Number of frequencies that could be synthesized
+     */
+    size_t computeRegistersHz(const uint64_t *freqsHz, size_t count, ADF4351RegisterSet *out,
+                              uint32_t channelSpacingHz = 10000UL) const;
+    
+#ifndef ADF4351_NO_FLOAT
+    /**
+     * @brief Calculate the output frequency described by decoded registers
+     * @param info Decoded register fields
+     * @param refFreqMHz Reference input frequency in MHz
+     * @return Output frequency in MHz (0 if the fields are invalid)
+     */
+    static double calcOutputFrequency(const ADF4351RegisterInfo &info, double refFreqMHz);
+    
+    /**
+     * @brief Calculate register words for a frequency without writing them
+     * @param freqMHz Output frequency in MHz
+     * @param channelSpacingMHz Frequency step in MHz
+     * @param regs Array to receive the register words (indexed R0-R5)
+     * @return true if the frequency can be synthesized
+     */
+    bool computeRegisters(double freqMHz, double channelSpacingMHz, uint32_t regs[6]) const;
+    
+    /**
+     * @brief Estimate the time needed to retune between two register sets
+     * 
+     * Behavioural model: SPI write time from ADF4351_SPI_CLOCK_HZ, band
+     * selection from the R4 band select clock divider, and settling of a
+     * second-order loop from the VCO frequency step.
+     * 
+     * @param fromRegs Register words currently in the chip (R0-R5)
+     * @param toRegs Register words to be written (R0-R5)
+     * @param refFreqMHz Reference input frequency in MHz
+     * @param loop Loop filter parameters
+     * @param est Structure to receive the estimate
+     */
+    static void estimateLockTime(const uint32_t fromRegs[6], const uint32_t toRegs[6],
+                                 double refFreqMHz, const ADF4351LoopFilter &loop,
+                                 ADF4351LockEstimate &est);
+    
+    /**
+     * @brief Estimate the maximum hop rate for a list of frequencies
+     * 
+     * Hops are taken in order starting from the registers currently
+     * programmed. The rate is limited by the slowest hop.
+     * 
+     * @param freqsMHz Hop frequencies in MHz
+     * @param count Number of hops
+     * @param channelSpacingMHz Frequency step in MHz
+     * @param loop Loop filter parameters
+     * @param estimates Optional array of count entries to receive per-hop estimates
+     * @return Maximum hop rate in Hz, or 0 if any frequency is invalid
+     */
+    double planHopRate(const double *freqsMHz, uint16_t count, double channelSpacingMHz,
+                       const ADF4351LoopFilter &loop, ADF4351LockEstimate *estimates = NULL) const;
+    
+    /**
+     * @brief Predict the total time to visit a list of frequencies in order
+     * @param freqsMHz Hop frequencies in MHz
+     * @param count Number of hops
+     * @param channelSpacingMHz Frequency step in MHz
+     * @param loop Loop filter parameters
+     * @return Sum of the per-hop lock time estimates in microseconds, or 0 if any frequency is invalid
+     */
+    double predictHopTime(const double *freqsMHz, uint16_t count, double channelSpacingMHz,
+                          const ADF4351LoopFilter &loop) const;
+    
+    /**
+     * @brief Reorder a hop list to minimize divider changes and VCO steps
+     * 
+     * For hop lists whose order does not matter (e.g. scans). Groups the
+     * frequencies by output divider band so each band is recalibrated once,
+     * and orders each band by VCO frequency. Sorts in place without heap
+     * allocation (insertion sort, so keep lists to a few hundred entries
+     * on small MCUs).
+     * 
+     * @param freqsMHz Hop frequencies in MHz, reordered in place
+     * @param count Number of hops
+     * @param channelSpacingMHz Frequency step in MHz
+     * @param loop Loop filter parameters
+     * @param beforeUs Optional output for the predicted time of the original order
+     * @param afterUs Optional output for the predicted time of the new order
+     * @return true if reordered, false if any frequency is invalid (list unchanged)
+     */
+    bool reorderHops(double *freqsMHz, uint16_t count, double channelSpacingMHz,
+                     const ADF4351LoopFilter &loop, double *beforeUs = NULL, double *afterUs = NULL) const;
+#endif
+
+protected:
+    // Frequency-dependent fields of R0, R1 and R4
+    struct FrequencyWords {
+        uint16_t nInt;
+        uint16_t nFrac;
+        uint16_t mod;
+        uint8_t rfDivSel;
+    };
+    
+    /**
+     * @brief Calculate the modulus for a channel spacing
+     * @param channelSpacingHz Frequency step in Hz
+     * @param pfdNumHz Reference frequency times the doubler factor, in Hz
+     * @param pfdDen R counter times the divide-by-2 factor
+     * @return MOD (1-4095), or 0 if the spacing is 0
+     */
+    static inline uint16_t calcModulus(uint32_t channelSpacingHz, uint32_t pfdNumHz, uint16_t pfdDen);
+    
+    /**
+     * @brief Calculate INT, FRAC and output divider for a frequency
+     * 
+     * Shared by ADF4351 and ADF4351T. The PFD is passed as the exact
+     * fraction pfdNumHz / pfdDen, and the function is defined inline so
+     * that a compile-time PFD folds into the arithmetic.
+     * 
+     * @param freqHz Output frequency in Hz
+     * @param MOD Modulus from calcModulus()
+     * @param pfdNumHz Reference frequency times the doubler factor, in Hz
+     * @param pfdDen R counter times the divide-by-2 factor
+     * @param w Structure to receive the calculated fields
+     * @return true if the VCO frequency and N are in range for the prescaler
+     */
+    static inline bool calcFrequencyWords(uint64_t freqHz, uint16_t MOD,
+                                          uint32_t pfdNumHz, uint16_t pfdDen,
+                                          FrequencyWords &w);
+    
+    /**
+     * @brief Assemble all six register words from the frequency fields
+     * @param w Frequency fields from calcFrequencyWords()
+     * @param regs Array to receive the register words (indexed R0-R5)
+     */
+    void buildRegisters(const FrequencyWords &w, uint32_t regs[6]) const;
+    
+    /**
+     * @brief Record register words that have just been written
+     * @param regs Register words (indexed R0-R5)
+     * @param channelSpacingHz Frequency step used to compute them
+     */
+    void storeRegisters(const uint32_t regs[6], uint32_t channelSpacingHz);
+    
+    /**
+     * @brief Record register words whose output frequency is already known
+     * @param regs Register words (indexed R0-R5)
+     * @param channelSpacingHz Frequency step used to compute them
+     * @param actualFreqHz Output frequency synthesized by regs
+     */
+    void storeRegisters(const uint32_t regs[6], uint32_t channelSpacingHz, uint64_t actualFreqHz);
+    
+    /**
+     * @brief Select appropriate output divider for frequency range
+     * @param freqHz Output frequency in Hz
+     * @param outDivider Reference to store divider value
+     * @param outRFdivSel Reference to store RF divider select code
+     */
+    static inline void selectOutputDivider(uint64_t freqHz, uint8_t &outDivider, uint8_t &outRFdivSel);
+    
+    /**
+     * @brief Check a frequency against the 35 MHz - 4.4 GHz output range
+     * @param freqHz Output frequency in Hz
+     * @return true if the frequency is within range
+     */
+    static inline bool inRange(uint64_t freqHz);
+    
+#ifndef ADF4351_NO_FLOAT
+    // Convert MHz to Hz, rounding to the nearest Hz
+    static uint64_t toHz(double freqMHz) {
+        return (uint64_t)(freqMHz * 1e6 + 0.5);
+    }
+#endif
+    
+    /**
+     * @brief Set the power-down bits in an R2 or R4 word
+     * @param data Register word to be written
+     * @return data with power-down set if it is R2 or R4, otherwise unchanged
+     */
+    static inline uint32_t powerDownWord(uint32_t data) {
+        uint8_t reg = data & 0x7;
+        if (reg == 2) return data | (1UL << 5);
+        if (reg == 4) return data | (1UL << 11);
+        return data;
+    }
+    
+    /**
+     * @brief Map a target frequency onto the nominal reference
+     * 
+     * The reference correction is applied in the frequency domain so the
+     * PFD fraction stays small enough for the 64-bit register arithmetic.
+     * 
+     * @param freqHz Output frequency in Hz
+     * @return Frequency to synthesize with the uncorrected PFD, in Hz
+     */
+    uint64_t toNominalHz(uint64_t freqHz) const {
+        if (_refCorrectionPpb == 0) {
+            return freqHz;
+        }
+        uint64_t scale = 1000000000ULL + _refCorrectionPpb;
+        return (freqHz * 1000000000ULL + scale / 2) / scale;
+    }
+    
+    /**
+     * @brief Register calculation substituted into the shared update path
+     * @param synth Driver whose settings apply
+     * @param freqHz Output frequency in Hz
+     * @param channelSpacingHz Frequency step in Hz
+     * @param regs Array to receive the register words (indexed R0-R5)
+     * @return true if the VCO frequency is in range
+     */
+    typedef bool (*ComputeFunction)(const ADF4351 &synth, uint64_t freqHz, uint32_t channelSpacingHz,
+                                    uint32_t regs[6]);
+    
+    /**
+     * @brief Set the output frequency with a substitute register calculation
+     * 
+     * Runs the same update as the public overload (cache, changed-register
+     * writes, statistics and trace); ADF4351T passes its compile-time PFD
+     * calculation.
+     * 
+     * @param freqHz Desired output frequency in Hz (35 MHz - 4.4 GHz)
+     * @param channelSpacingHz Frequency step/channel spacing in Hz
+     * @param compute Register calculation, or NULL for computeRegistersHz()
+     * @return true if frequency was set successfully, false otherwise
+     */
+    bool setFrequencyHz(uint64_t freqHz, uint32_t channelSpacingHz, ComputeFunction compute);
+    
+    int32_t _refCorrectionPpb;
 
 private:
+    uint64_t _outputFreqHz;
+    bool _sleeping;
     uint8_t _lePin;
-    double _refFreqMHz;
-    double _outputFreqMHz;
-    double _pfdFreqMHz;
+    uint32_t _refFreqHz;
+    uint64_t _actualFreqHz;
+    uint32_t _channelSpacingHz;
+    
+    // PFD frequency as the exact fraction _pfdNumHz / _pfdDen
+    uint32_t _pfdNumHz;
+    uint16_t _pfdDen;
+    
+    // Last written register words (R0-R5) and which of them the chip holds
+    uint32_t _reg[6];
+    uint8_t _regValid;
+    
+#if ADF4351_CACHE_SIZE > 0
+    // Memoized register sets, replaced round-robin
+    struct CacheEntry {
+        uint64_t freqHz;
+        uint32_t channelSpacingHz;
+        uint64_t actualFreqHz;
+        uint32_t regs[6];
+        uint16_t generation;
+    };
+    CacheEntry _cache[ADF4351_CACHE_SIZE];
+    uint8_t _cacheCount;
+    uint8_t _cacheNext;
+    uint32_t _cacheHits;
+    uint32_t _cacheMisses;
+#endif
+    
+    // Linear sweep state: the FRAC accumulator remainder and the per-step
+    // increments of INT, FRAC and remainder within one divider band. With a
+    // reference correction the nominal step is not a whole number of Hz, so
+    // the nominal frequency carries its own remainder and an extra 1 Hz
+    // increment is added when it overflows.
+    bool _sweepActive;
+    int32_t _sweepStepHz;
+    uint8_t _sweepDivSel;
+    uint32_t _sweepRem;
+    uint16_t _sweepStepInt;
+    uint16_t _sweepStepFrac;
+    uint32_t _sweepStepRem;
+    uint64_t _sweepNominalHz;
+    uint32_t _sweepNomRem;
+    uint32_t _sweepNomStepHz;
+    uint32_t _sweepNomStepRem;
+    uint16_t _sweepUnitFrac;
+    uint32_t _sweepUnitRem;
+    
+#ifdef ADF4351_STATS
+    ADF4351Stats _stats;
+#endif
+    
+    // End of the last register burst that wrote R0
+    uint32_t _tuneUs;
+    
+#ifdef ADF4351_LOCK_HISTOGRAM
+    // Lock time histograms per output divider band; a band is halved when
+    // a bucket would overflow so it keeps tracking recent behaviour
+    uint16_t _lockHist[7][ADF4351_LOCK_BUCKETS];
+    uint8_t _lockPercentile;
+    volatile bool _lockAnomalous;
+    uint32_t _lockAnomalies;
+#endif
+    
+#if ADF4351_TRACE_SIZE > 0
+    // Event trace ring, overwriting the oldest entry when full
+    ADF4351TraceEntry _trace[ADF4351_TRACE_SIZE];
+    uint16_t _traceHead;
+    uint16_t _traceCount;
+#endif
+    
+    // Latest pending frequency request (written from interrupts)
+    volatile bool _requestPending;
+    uint64_t _requestFreqHz;
+    uint32_t _requestSpacingHz;
+    uint32_t _requestsCoalesced;
+    
+    // Hop table (owned by the caller)
+    ADF4351HopEntry *_hopTable;
+    uint16_t _hopCount;
+    uint32_t _hopSpacingHz;
+    
+    // Bumped by every settings change; cached and hop table words from an
+    // older generation are recomputed on use
+    uint16_t _generation;
+    
+    // Last measured wake-to-lock time
+    uint32_t _wakeTimeUs;
+    
+    // Prepared FMCW ramp (R0 words owned by the caller)
+    const uint32_t *_rampWords;
+    uint16_t _rampLength;
+    uint16_t _rampIndex;
+    int8_t _rampDir;
+    uint8_t _rampShape;
+    
+    // Prepared FSK/OOK bitstream (bits owned by the caller) and the register
+    // words sent for 0 and 1 bits. For FSK, the tone not being sent.
+    uint32_t _keyWords[2];
+    uint64_t _keyAltFreqHz;
+    uint64_t _keyAltActualHz;
+    const uint8_t *_keyBits;
+    uint32_t _keyBitCount;
+    uint32_t _keyIndex;
+    uint8_t _keyReg;
+    
+#ifdef ADF4351_SCHEDULE
+    // Command schedule (storage owned by the caller), kept sorted latest
+    // first so the next command is always the last entry. Scheduled words
+    // follow their own generation, which ignores output power and enable.
+    ADF4351TimedCommand *_schedule;
+    uint8_t _scheduleCapacity;
+    volatile uint8_t _scheduleCount;
+    uint16_t _planGeneration;
+    ADF4351ScheduleStats _scheduleStats;
+    uint64_t _scheduleLateSumUs;
+    
+    // Set while a register write holds the bus; serviceSchedule() called
+    // meanwhile from an interrupt is deferred to the end of that write
+    volatile bool _busBusy;
+    volatile bool _scheduleDeferred;
+#endif
     
     // Reference settings
     uint8_t _rCounter;
@@ -104,19 +1409,321 @@ private:
     void writeRegister(uint32_t data);
     
     /**
-     * @brief Calculate and write all registers for current frequency
-     * @param channelSpacingMHz Frequency step in MHz
+     * @brief Write a set of registers in one SPI transaction, R5 first
+     * @param regs Register words (indexed R0-R5)
+     * @param mask Bit i set to write register i
+     */
+    void writeRegisters(const uint32_t regs[6], uint8_t mask);
+    
+    /**
+     * @brief Shift one 32-bit word out and latch it (inside a transaction)
+     * @param data 32-bit register value to write
+     */
+    void shiftRegister(uint32_t data);
+    
+    /**
+     * @brief Find the registers that must be written to load a register set
+     * @param regs Register words about to be written (indexed R0-R5)
+     * @return Bit mask of registers that differ from the chip, always including R0
+     */
+    uint8_t dirtyRegisters(const uint32_t regs[6]) const;
+    
+    /**
+     * @brief Calculate all registers for current frequency and write the changed ones
+     * @param channelSpacingHz Frequency step in Hz
+     * @param compute Register calculation, or NULL for computeRegistersHz()
      * @return true if successful
      */
-    bool updateRegisters(double channelSpacingMHz);
+    bool updateRegisters(uint32_t channelSpacingHz, ComputeFunction compute = NULL);
     
     /**
-     * @brief Select appropriate output divider for frequency range
-     * @param freqMHz Output frequency in MHz
-     * @param outDivider Reference to store divider value
-     * @param outRFdivSel Reference to store RF divider select code
+     * @brief Compute the current sweep step in full and restart the incremental state
+     * @return false if the frequency cannot be synthesized (the sweep ends)
+     */
+    bool fullSweepStep();
+    
+    /**
+     * @brief Derive the incremental sweep state from the registers just written
+     */
+    void resetSweepState();
+    
+    /**
+     * @brief End any sweep, ramp or bitstream, since each replays words derived from the registers being replaced
+     */
+    void stopStreams();
+    
+    /**
+     * @brief Mark all precomputed register words stale after a settings change
+     * @param outputOnly true if only the output power or enable changed
+     */
+    void invalidateRegisters(bool outputOnly = false);
+    
+#ifdef ADF4351_SCHEDULE
+    /**
+     * @brief Insert a command into the schedule by time
+     * @param cmd Command to insert
+     * @return false if the queue is full or not set
+     */
+    bool enqueueCommand(const ADF4351TimedCommand &cmd);
+    
+    /**
+     * @brief Apply one scheduled command
+     * @param cmd Command to apply
+     * @return false if the frequency could not be recomputed (nothing written)
+     */
+    bool fireCommand(ADF4351TimedCommand &cmd);
+    
+    /**
+     * @brief Take the bus for a register write or a schedule run
+     * @return false if it is already held (by the caller or the code an interrupt preempted)
+     */
+    bool claimBus();
+    
+    /**
+     * @brief Give up the bus and apply commands deferred while it was held
+     * @return Number of deferred commands applied
+     */
+    uint8_t releaseBus();
+#endif
+    
+    /**
+     * @brief Apply a reference configuration and describe it
+     * @param refFreqHz Reference input frequency in Hz
+     * @param rCounter Reference divider (R counter)
+     * @param refDoubler Reference doubler (0 or 1)
+     * @param refDiv2 Reference divide-by-2 (0 or 1)
+     * @param channelSpacingHz Frequency step in Hz
+     * @param config Optional structure to receive the configuration and the before/after PFD
+     */
+    void applyReference(uint32_t refFreqHz, uint8_t rCounter, uint8_t refDoubler, uint8_t refDiv2,
+                        uint32_t channelSpacingHz, ADF4351ReferenceConfig *config);
+    
+    /**
+     * @brief Predict the VCO band selection time for a PFD
+     * @param pfdNumHz Reference frequency times the doubler factor, in Hz
+     * @param pfdDen R counter times the divide-by-2 factor
+     * @return Band selection time in microseconds
      */
-    void selectOutputDivider(double freqMHz, double &outDivider, uint8_t &outRFdivSel);
+    uint32_t bandSelectTimeUs(uint32_t pfdNumHz, uint16_t pfdDen) const;
+    
+    /**
+     * @brief Map a frequency synthesized from the nominal reference onto the corrected one
+     * @param nominalHz Frequency computed with the uncorrected PFD, in Hz
+     * @return Frequency actually produced, in Hz
+     */
+    uint64_t fromNominalHz(uint64_t nominalHz) const;
+    
+    /**
+     * @brief Record a measured lock time for the current output divider band
+     * 
+     * No-op unless ADF4351_LOCK_HISTOGRAM is defined.
+     * 
+     * @param lockUs Time from retune to lock in microseconds
+     * @param locked false if the wait timed out
+     */
+    void recordLockTime(uint32_t lockUs, bool locked);
+    
+    /**
+     * @brief Fletcher-16 checksum of a saved state, excluding the checksum field
+     */
+    static uint16_t stateChecksum(const ADF4351SavedState &state);
+    
+    /**
+     * @brief Append an event to the trace ring (no-op when tracing is disabled)
+     * @param event ADF4351TraceEvent
+     * @param value Register word or call argument
+     */
+    void trace(uint8_t event, uint32_t value);
+    
+#ifdef ADF4351_STATS
+    /**
+     * @brief Add one sample to a timing record
+     * @param timing Timing record to update
+     * @param us Duration of the sample in microseconds
+     */
+    static void recordTiming(ADF4351Timing &timing, uint32_t us);
+#endif
+    
+#ifndef ADF4351_NO_FLOAT
+    /**
+     * @brief Run the lock-time model over a hop list
+     * @param freqsMHz Hop frequencies in MHz
+     * @param count Number of hops
+     * @param channelSpacingMHz Frequency step in MHz
+     * @param loop Loop filter parameters
+     * @param estimates Optional array of count entries to receive per-hop estimates
+     * @param worstUs Receives the slowest hop time in microseconds
+     * @param totalUs Receives the sum of all hop times in microseconds
+     * @return false if any frequency is invalid
+     */
+    bool walkHops(const double *freqsMHz, uint16_t count, double channelSpacingMHz,
+                  const ADF4351LoopFilter &loop, ADF4351LockEstimate *estimates,
+                  double &worstUs, double &totalUs) const;
+#endif
+};
+
+inline void ADF4351::selectOutputDivider(uint64_t freqHz, uint8_t &outDivider, uint8_t &outRFdivSel) {
+    // Branchless: the divider select code counts the band edges above freqHz
+    // (2200, 1100, 550, 275, 137.5 and 68.75 MHz)
+    outRFdivSel = (uint8_t)((freqHz < 2200000000ULL) + (freqHz < 1100000000ULL) +
+                            (freqHz < 550000000ULL) + (freqHz < 275000000ULL) +
+                            (freqHz < 137500000ULL) + (freqHz < 68750000ULL));
+    outDivider = (uint8_t)(1 << outRFdivSel);
+}
+
+inline bool ADF4351::inRange(uint64_t freqHz) {
+    return freqHz >= 35000000ULL && freqHz <= 4400000000ULL;
+}
+
+inline uint16_t ADF4351::calcModulus(uint32_t channelSpacingHz, uint32_t pfdNumHz, uint16_t pfdDen) {
+    if (channelSpacingHz == 0) {
+        return 0;
+    }
+    
+    // Calculate modulus for desired channel spacing, rounded to nearest
+    uint64_t modDen = (uint64_t)pfdDen * channelSpacingHz;
+    uint64_t mod = (pfdNumHz + modDen / 2) / modDen;
+    if (mod > 4095) mod = 4095;
+    if (mod < 1) mod = 1;
+    return (uint16_t)mod;
+}
+
+inline bool ADF4351::calcFrequencyWords(uint64_t freqHz, uint16_t MOD,
+                                        uint32_t pfdNumHz, uint16_t pfdDen,
+                                        FrequencyWords &w) {
+    if (MOD == 0) {
+        return false;
+    }
+    
+    // Select output divider
+    uint8_t outputDivider;
+    selectOutputDivider(freqHz, outputDivider, w.rfDivSel);
+    
+    // Calculate VCO frequency
+    uint64_t vcoFreqHz = freqHz * outputDivider;
+    
+    // Validate VCO frequency range (2200-4400 MHz)
+    if (vcoFreqHz < 2200000000ULL || vcoFreqHz > 4400000000ULL) {
+        return false;
+    }
+    
+    // Calculate PLL N value: N = vco / pfd = vco * pfdDen / pfdNumHz
+    uint64_t nScaled = vcoFreqHz * pfdDen;
+    uint64_t N_int = nScaled / pfdNumHz;
+    uint32_t remainder = (uint32_t)(nScaled - N_int * pfdNumHz);
+    
+    // Calculate fractional value, rounded to nearest
+    uint16_t N_frac = (uint16_t)(((uint64_t)remainder * MOD + pfdNumHz / 2) / pfdNumHz);
+    if (N_frac >= MOD) {
+        N_int += N_frac / MOD;
+        N_frac = N_frac % MOD;
+    }
+    
+    // INT is a 16-bit field, so low PFDs cannot reach the top of the VCO
+    // range. N < 75 selects the 4/5 prescaler, which needs N >= 23 and
+    // only runs up to a 3.6 GHz VCO.
+    if (N_int > 65535 || N_int < 23 || (N_int < 75 && vcoFreqHz > 3600000000ULL)) {
+        return false;
+    }
+    
+    w.nInt = (uint16_t)N_int;
+    w.nFrac = N_frac;
+    w.mod = MOD;
+    return true;
+}
+
+/**
+ * @brief ADF4351 driver with the LE pin and reference fixed at compile time
+ * 
+ * The PFD fraction is a compile-time constant, so the divisions in the
+ * register arithmetic become multiplies and shifts. The reference cannot
+ * be changed at run time.
+ * 
+ * @tparam LePin Latch Enable (LE/CS) pin number
+ * @tparam RefHz Reference input frequency in Hz
+ * @tparam R Reference divider (R counter)
+ * @tparam Doubler Enable reference doubler (0 or 1)
+ * @tparam Div2 Enable reference divide-by-2 (0 or 1)
+ */
+template <uint8_t LePin, uint32_t RefHz, uint8_t R = 1, uint8_t Doubler = 0, uint8_t Div2 = 0>
+class ADF4351T : public ADF4351 {
+public:
+    ADF4351T() : ADF4351(LePin) {
+        ADF4351::setReferenceHz(RefHz, R, Doubler, Div2);
+    }
+    
+    /**
+     * @brief Initialize the ADF4351 with the compile-time reference
+     */
+    void begin() {
+        ADF4351::beginHz(RefHz);
+    }
+    
+    /**
+     * @brief Initialize the ADF4351 and restore a saved state
+     * @param state State from saveState(), e.g. read back from EEPROM
+     * @return true if restored, false if the state is invalid or was saved
+     *         with a different reference configuration (nothing is written)
+     */
+    bool begin(const ADF4351SavedState &state) {
+        if (state.refFreqHz != RefHz || state.rCounter != R ||
+            state.refDoubler != Doubler || state.refDiv2 != Div2) {
+            return false;
+        }
+        return ADF4351::begin(state);
+    }
+    
+    /**
+     * @brief Set the output frequency
+     * @param freqHz Desired output frequency in Hz (35 MHz - 4.4 GHz)
+     * @param channelSpacingHz Frequency step/channel spacing in Hz (default 10 kHz)
+     * @return true if frequency was set successfully, false otherwise
+     */
+    bool setFrequencyHz(uint64_t freqHz, uint32_t channelSpacingHz = 10000UL) {
+        return ADF4351::setFrequencyHz(freqHz, channelSpacingHz, computeFixed);
+    }
+    
+#ifndef ADF4351_NO_FLOAT
+    /**
+     * @brief Set the output frequency
+     * @param freqMHz Desired output frequency in MHz (35 - 4400 MHz)
+     * @param channelSpacingMHz Frequency step/channel spacing in MHz (default 0.01 MHz = 10 kHz)
+     * @return true if frequency was set successfully, false otherwise
+     */
+    bool setFrequency(double freqMHz, double channelSpacingMHz = 0.01) {
+        if (freqMHz < 35.0 || freqMHz > 4400.0 || channelSpacingMHz <= 0.0) {
+            return false;
+        }
+        return setFrequencyHz(toHz(freqMHz), (uint32_t)toHz(channelSpacingMHz));
+    }
+#endif
+
+private:
+    static const uint32_t kPfdNumHz = RefHz * (1 + Doubler);
+    static const uint16_t kPfdDen = R * (1 + Div2);
+    
+    // The reference is fixed by the template parameters
+    using ADF4351::beginHz;
+    using ADF4351::setReferenceHz;
+    using ADF4351::setReferenceAutoHz;
+    using ADF4351::planReferenceHz;
+#ifndef ADF4351_NO_FLOAT
+    using ADF4351::setReference;
+    using ADF4351::setReferenceAuto;
+#endif
+    
+    // Register calculation with the PFD folded in
+    static bool computeFixed(const ADF4351 &synth, uint64_t freqHz, uint32_t channelSpacingHz,
+                             uint32_t regs[6]) {
+        const ADF4351T &self = static_cast<const ADF4351T &>(synth);
+        FrequencyWords w;
+        uint16_t mod = calcModulus(channelSpacingHz, kPfdNumHz, kPfdDen);
+        if (!calcFrequencyWords(self.toNominalHz(freqHz), mod, kPfdNumHz, kPfdDen, w)) {
+            return false;
+        }
+        self.buildRegisters(w, regs);
+        return true;
+    }
 };
 
 #endif // ADF4351_H
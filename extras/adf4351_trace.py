@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""
+adf4351_trace.py - Decode an ADF4351 trace dump into a timeline
+
+Reads the binary stream written by ADF4351::dumpTrace() (captured from the
+serial port into a file, or piped on stdin) and prints one line per event
+with the time relative to the first entry. Each frequency change is paired
+with the R0 write that completes it to report the per-hop latency.
+
+Usage:
+    python3 adf4351_trace.py trace.bin
+    python3 adf4351_trace.py < trace.bin
+"""
+
+import struct
+import sys
+
+EVENTS = {
+    0x10: "begin",
+    0x11: "setReference",
+    0x12: "setFrequency",
+    0x13: "setOutputPower",
+    0x14: "enableOutput",
+    0x15: "setChargePumpCurrent",
+    0x16: "sweepStep",
+    0x17: "prepareRamp",
+    0x18: "sleep",
+    0x19: "wake",
+    0x1A: "setReferenceCorrection",
+}
+
+# Calls whose value is an output frequency in kHz and which end with an R0 write
+HOP_EVENTS = (0x12, 0x16)
+
+# Calls whose value is a signed 32-bit integer
+SIGNED_EVENTS = (0x1A,)
+
+ENTRY = struct.Struct("<BII")
+
+
+def read_trace(data):
+    """Parse a dump and return a list of (event, timeUs, value) tuples."""
+    start = data.find(b"ADFT")
+    if start < 0 or len(data) < start + 7:
+        raise ValueError("no ADFT header found")
+    version = data[start + 4]
+    if version != 1:
+        raise ValueError("unsupported trace version %d" % version)
+    count = struct.unpack_from("<H", data, start + 5)[0]
+
+    entries = []
+    offset = start + 7
+    for _ in range(count):
+        if offset + ENTRY.size > len(data):
+            break
+        event, time_us, value = ENTRY.unpack_from(data, offset)
+        offset += ENTRY.size
+        if event != 0xFF:
+            entries.append((event, time_us, value))
+    return entries
+
+
+def describe(event, value):
+    if event <= 5:
+        return "R%d  0x%08X" % (event, value)
+    name = EVENTS.get(event, "event 0x%02X" % event)
+    if event in HOP_EVENTS:
+        return "%s %.3f MHz" % (name, value / 1000.0)
+    if event in (0x10, 0x11):
+        return "%s %.6f MHz" % (name, value / 1e6)
+    if event in SIGNED_EVENTS and value >= 0x80000000:
+        value -= 0x100000000
+    return "%s %d" % (name, value)
+
+
+def main():
+    if len(sys.argv) > 1:
+        with open(sys.argv[1], "rb") as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+
+    entries = read_trace(data)
+    if not entries:
+        print("trace is empty")
+        return
+
+    t0 = entries[0][1]
+    hop_start = None
+    latencies = []
+    for event, time_us, value in entries:
+        # micros() wraps every ~71 minutes
+        rel_us = (time_us - t0) & 0xFFFFFFFF
+        line = "%12d us  %s" % (rel_us, describe(event, value))
+
+        if event in HOP_EVENTS:
+            hop_start = time_us
+        elif event == 0 and hop_start is not None:
+            latency = (time_us - hop_start) & 0xFFFFFFFF
+            latencies.append(latency)
+            line += "   (hop latency %d us)" % latency
+            hop_start = None
+        print(line)
+
+    if latencies:
+        latencies.sort()
+        print()
+        print("hops: %d  latency min %d us  median %d us  max %d us" % (
+            len(latencies), latencies[0], latencies[len(latencies) // 2], latencies[-1]))
+
+
+if __name__ == "__main__":
+    main()
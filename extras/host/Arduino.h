@@ -0,0 +1,49 @@
+/*
+ * Arduino.h - host stand-in for the Arduino core used by the host checks
+ *
+ * Only the calls the library makes are provided. Time is simulated: every
+ * micros() call advances the clock by 1 us, delayMicroseconds() and SPI
+ * transfers advance it by their duration. Pin writes and SPI bytes drive
+ * the chip model in sim.h.
+ */
+
+#ifndef ARDUINO_H_HOST
+#define ARDUINO_H_HOST
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __AVR__
+// SREG and cli() for the library's interrupt lock ("make size")
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#endif
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+uint32_t micros();
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+void noInterrupts();
+void interrupts();
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t b) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        size_t n = 0;
+        while (size--) n += write(*buffer++);
+        return n;
+    }
+};
+
+#endif // ARDUINO_H_HOST
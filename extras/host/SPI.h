@@ -0,0 +1,32 @@
+/*
+ * SPI.h - host stand-in for the Arduino SPI library used by the host checks
+ */
+
+#ifndef SPI_H_HOST
+#define SPI_H_HOST
+
+#include <stdint.h>
+
+#define MSBFIRST 1
+#define SPI_MODE0 0
+
+class SPISettings {
+public:
+    SPISettings(uint32_t clockHz, uint8_t bitOrder, uint8_t dataMode)
+        : clockHz(clockHz) { (void)bitOrder; (void)dataMode; }
+    uint32_t clockHz;
+};
+
+class SPIClass {
+public:
+    void begin() {}
+    void setDataMode(uint8_t) {}
+    void setBitOrder(uint8_t) {}
+    void beginTransaction(SPISettings settings);
+    void endTransaction();
+    uint8_t transfer(uint8_t data);
+};
+
+extern SPIClass SPI;
+
+#endif // SPI_H_HOST
@@ -0,0 +1,108 @@
+/*
+ * check_cache.cpp - setFrequency() memoization (built with ADF4351_CACHE_SIZE=4)
+ *
+ * Repeat requests must hit and write exactly the words a fresh
+ * calculation gives, entries are replaced round-robin, and every
+ * settings change must make the next request recompute.
+ */
+
+#include "ADF4351.h"
+#include "sim.h"
+
+static ADF4351 synth(SIM_LE_PIN);
+static ADF4351 plain(SIM_LE_PIN);
+
+// Tune and compare against an uncached calculation; returns true on a cache hit
+static bool tune(uint64_t freqHz, uint32_t spacingHz = 10000UL) {
+    uint32_t hits = synth.getCacheHits();
+    uint32_t misses = synth.getCacheMisses();
+    SIM_CHECK(synth.setFrequencyHz(freqHz, spacingHz));
+    bool hit = synth.getCacheHits() == hits + 1;
+    SIM_CHECK(hit != (synth.getCacheMisses() == misses + 1));
+    
+    uint32_t regs[6];
+    SIM_CHECK(plain.computeRegistersHz(freqHz, spacingHz, regs));
+    for (uint8_t i = 0; i < 6; i++) {
+        SIM_CHECK(synth.getRegister(i) == regs[i]);
+        SIM_CHECK(simChip.reg[i] == regs[i]);
+    }
+    SIM_CHECK(synth.verifyRegisters());
+    SIM_CHECK(simOutputHz(25000000UL) == synth.getActualFrequencyHz());
+    return hit;
+}
+
+int main() {
+    synth.beginHz(25000000UL);
+    plain.beginHz(25000000UL);
+    SIM_CHECK(synth.getCacheHits() == 0 && synth.getCacheMisses() == 0);
+    
+    // Hits after the first request; the spacing is part of the key
+    SIM_CHECK(!tune(1000100000ULL));
+    SIM_CHECK(tune(1000100000ULL));
+    SIM_CHECK(!tune(1000100000ULL, 1000UL));
+    SIM_CHECK(tune(1000100000ULL, 1000UL));
+    
+    // A hit still only writes the registers that differ from the chip
+    SIM_CHECK(!tune(1000200000ULL));
+    uint32_t words = simChip.words;
+    SIM_CHECK(tune(1000100000ULL));
+    SIM_CHECK(simChip.words - words == 1);
+    
+    // Four entries, replaced round-robin: the fifth distinct request evicts the oldest
+    SIM_CHECK(!tune(2000000000ULL));
+    SIM_CHECK(!tune(3000000000ULL));
+    SIM_CHECK(tune(1000200000ULL));
+    SIM_CHECK(!tune(1000100000ULL));
+    SIM_CHECK(tune(2000000000ULL));
+    SIM_CHECK(!tune(1000100000ULL, 1000UL));
+    
+    // Output power, output enable, charge pump current and the reference
+    // each invalidate the stored words
+    synth.setOutputPower(1);
+    plain.setOutputPower(1);
+    SIM_CHECK(!tune(2000000000ULL));
+    SIM_CHECK(tune(2000000000ULL));
+    synth.enableOutput(false);
+    plain.enableOutput(false);
+    SIM_CHECK(!tune(2000000000ULL));
+    synth.enableOutput(true);
+    plain.enableOutput(true);
+    SIM_CHECK(!tune(2000000000ULL));
+    synth.setChargePumpCurrent(3);
+    plain.setChargePumpCurrent(3);
+    SIM_CHECK(!tune(2000000000ULL));
+    SIM_CHECK(tune(2000000000ULL));
+    synth.setReferenceHz(25000000UL, 2);
+    plain.setReferenceHz(25000000UL, 2);
+    SIM_CHECK(!tune(2000000000ULL));
+    SIM_CHECK(tune(2000000000ULL));
+    synth.setReferenceHz(25000000UL);
+    plain.setReferenceHz(25000000UL);
+    
+    // A stale entry is recomputed in its own slot, so the others survive
+    SIM_CHECK(!tune(1000100000ULL));
+    SIM_CHECK(!tune(1000200000ULL));
+    SIM_CHECK(!tune(3000000000ULL));
+    SIM_CHECK(!tune(2000000000ULL));
+    synth.setOutputPower(2);
+    plain.setOutputPower(2);
+    SIM_CHECK(!tune(1000100000ULL));
+    SIM_CHECK(!tune(1000200000ULL));
+    SIM_CHECK(tune(1000100000ULL));
+    
+    // clearCache() forgets everything
+    synth.clearCache();
+    SIM_CHECK(!tune(1000100000ULL));
+    
+    // Generation wrap-around clears the cache rather than matching old entries
+    for (uint32_t n = 0; n < 70000; n++) {
+        synth.setChargePumpCurrent(n & 1 ? 3 : 4);
+    }
+    synth.setChargePumpCurrent(3);
+    plain.setChargePumpCurrent(3);
+    SIM_CHECK(!tune(1000100000ULL));
+    SIM_CHECK(tune(1000100000ULL));
+    
+    printf("%u hits, %u misses\n", synth.getCacheHits(), synth.getCacheMisses());
+    return simFinish("cache");
+}
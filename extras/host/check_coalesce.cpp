@@ -0,0 +1,71 @@
+/*
+ * check_coalesce.cpp - requestFrequencyHz() / service() coalescing
+ *
+ * Requests arriving before service() runs must collapse to the latest,
+ * with each dropped one counted, and service() must apply it exactly
+ * once and leave interrupts as it found them.
+ */
+
+#include "ADF4351.h"
+#include "sim.h"
+
+int main() {
+    ADF4351 synth(SIM_LE_PIN);
+    ADF4351 plain(SIM_LE_PIN);
+    synth.beginHz(25000000UL);
+    plain.beginHz(25000000UL);
+    
+    // Nothing pending
+    uint32_t words = simChip.words;
+    SIM_CHECK(!synth.service());
+    SIM_CHECK(simChip.words == words);
+    SIM_CHECK(synth.getCoalescedRequests() == 0);
+    
+    // One request, one update
+    synth.requestFrequencyHz(1000000000ULL);
+    SIM_CHECK(simInterruptsEnabled);
+    SIM_CHECK(simChip.words == words);
+    SIM_CHECK(synth.service());
+    SIM_CHECK(synth.getFrequencyHz() == 1000000000ULL);
+    SIM_CHECK(synth.getCoalescedRequests() == 0);
+    SIM_CHECK(!synth.service());
+    
+    // A burst: the last request wins, with its own spacing, and only one
+    // update reaches the chip
+    for (uint32_t n = 0; n < 100; n++) {
+        synth.requestFrequencyHz(2400000000ULL + 1000000ULL * n);
+    }
+    synth.requestFrequencyHz(433920000ULL, 1000UL);
+    SIM_CHECK(synth.getCoalescedRequests() == 100);
+    uint32_t transactions = simChip.transactions;
+    SIM_CHECK(synth.service());
+    SIM_CHECK(simChip.transactions - transactions == 1);
+    SIM_CHECK(!synth.service());
+    SIM_CHECK(synth.getFrequencyHz() == 433920000ULL);
+    uint32_t regs[6];
+    SIM_CHECK(plain.computeRegistersHz(433920000ULL, 1000UL, regs));
+    for (uint8_t i = 0; i < 6; i++) {
+        SIM_CHECK(simChip.reg[i] == regs[i]);
+    }
+    SIM_CHECK(simInterruptsEnabled);
+    
+    // An out-of-range request is dropped by service() without touching the chip
+    synth.requestFrequencyHz(5000000000ULL);
+    words = simChip.words;
+    SIM_CHECK(!synth.service());
+    SIM_CHECK(!synth.service());
+    SIM_CHECK(simChip.words == words);
+    SIM_CHECK(synth.getFrequencyHz() == 433920000ULL);
+
+#ifndef ADF4351_NO_FLOAT
+    // The MHz wrapper maps invalid values to a rejected request
+    synth.requestFrequency(-1.0);
+    SIM_CHECK(!synth.service());
+    synth.requestFrequency(868.3, 0.001);
+    SIM_CHECK(synth.service());
+    SIM_CHECK(synth.getFrequencyHz() == 868300000ULL);
+#endif
+    
+    printf("%u requests coalesced\n", synth.getCoalescedRequests());
+    return simFinish("coalesce");
+}
@@ -0,0 +1,124 @@
+/*
+ * check_correction.cpp - reference correction and automatic reference setup
+ *
+ * A correction or reference change that the programmed frequency cannot
+ * follow must be refused with nothing changed; an accepted one must
+ * retune at once and reach cached hop table entries when they are used.
+ */
+
+#include "ADF4351.h"
+#include "sim.h"
+
+// Snapshot of everything a refused change must leave alone
+struct Snapshot {
+    uint32_t chip[6];
+    uint32_t words;
+    uint64_t actualHz;
+    uint32_t pfdHz;
+    int32_t ppb;
+};
+
+static Snapshot take(const ADF4351 &synth) {
+    Snapshot s;
+    for (uint8_t i = 0; i < 6; i++) {
+        s.chip[i] = simChip.reg[i];
+    }
+    s.words = simChip.words;
+    s.actualHz = synth.getActualFrequencyHz();
+    s.pfdHz = synth.getPFDFrequencyHz();
+    s.ppb = synth.getReferenceCorrectionPpb();
+    return s;
+}
+
+static void expectUnchanged(const ADF4351 &synth, const Snapshot &before) {
+    Snapshot after = take(synth);
+    for (uint8_t i = 0; i < 6; i++) {
+        SIM_CHECK(after.chip[i] == before.chip[i]);
+    }
+    SIM_CHECK(after.words == before.words);
+    SIM_CHECK(after.actualHz == before.actualHz);
+    SIM_CHECK(after.pfdHz == before.pfdHz);
+    SIM_CHECK(after.ppb == before.ppb);
+    SIM_CHECK(synth.verifyRegisters());
+}
+
+// The chip output, corrected for the reference error, is within half a channel
+static void expectOnFrequency(const ADF4351 &synth, uint64_t freqHz, uint32_t spacingHz) {
+    uint64_t nominalHz = simOutputHz(25000000UL);
+    int32_t ppb = synth.getReferenceCorrectionPpb();
+    uint64_t outHz = (nominalHz * (1000000000ULL + ppb) + 500000000ULL) / 1000000000ULL;
+    uint64_t errorHz = (outHz > freqHz) ? outHz - freqHz : freqHz - outHz;
+    SIM_CHECK(errorHz <= spacingHz / 2 + 1);
+    SIM_CHECK(synth.getActualFrequencyHz() == outHz);
+    SIM_CHECK(synth.verifyRegisters());
+}
+
+int main() {
+    ADF4351 synth(SIM_LE_PIN);
+    synth.beginHz(25000000UL);
+    
+    // Out of range, programmed or not
+    SIM_CHECK(!synth.setReferenceCorrectionPpb(1000001L));
+    SIM_CHECK(!synth.setReferenceCorrectionPpb(-1000001L));
+    SIM_CHECK(synth.getReferenceCorrectionPpb() == 0);
+    
+    // At 4.399 GHz a -0.1% correction asks for a 4.403 GHz VCO: refused,
+    // and the chip stays on the old words
+    SIM_CHECK(synth.setFrequencyHz(4399000000ULL));
+    Snapshot before = take(synth);
+    SIM_CHECK(!synth.setReferenceCorrectionPpb(-1000000L));
+    expectUnchanged(synth, before);
+    
+    // Within range it retunes at once
+    SIM_CHECK(synth.setReferenceCorrectionPpb(1000000L));
+    SIM_CHECK(synth.getReferenceCorrectionPpb() == 1000000L);
+    SIM_CHECK(simChip.words > before.words);
+    expectOnFrequency(synth, 4399000000ULL, 10000UL);
+    SIM_CHECK(synth.setReferenceCorrectionPpb(-2500));
+    expectOnFrequency(synth, 4399000000ULL, 10000UL);
+    
+    // Hop table entries pick up a new correction when they are next used
+    ADF4351 plain(SIM_LE_PIN);
+    plain.beginHz(25000000UL);
+    ADF4351HopEntry table[3];
+    table[0].freqHz = 433920000ULL;
+    table[1].freqHz = 2402000000ULL;
+    table[2].freqHz = 4390000000ULL;
+    SIM_CHECK(synth.setHopTable(table, 3, 10000UL));
+    SIM_CHECK(synth.setReferenceCorrectionPpb(15000));
+    SIM_CHECK(plain.setReferenceCorrectionPpb(15000));
+    for (uint8_t n = 0; n < 3; n++) {
+        uint16_t generation = table[n].generation;
+        SIM_CHECK(synth.hopTo(n));
+        SIM_CHECK(table[n].generation != generation);
+        uint32_t regs[6];
+        SIM_CHECK(plain.computeRegistersHz(table[n].freqHz, 10000UL, regs));
+        for (uint8_t i = 0; i < 6; i++) {
+            SIM_CHECK(table[n].regs[i] == regs[i]);
+            SIM_CHECK(simChip.reg[i] == regs[i]);
+        }
+        expectOnFrequency(synth, table[n].freqHz, 10000UL);
+    }
+    
+    // setReferenceAutoHz(): a 12 Hz spacing needs a PFD below 49.2 kHz,
+    // where N for 4.39 GHz no longer fits the INT field. Refused, nothing changed.
+    before = take(synth);
+    ADF4351ReferenceConfig config;
+    SIM_CHECK(!synth.setReferenceAutoHz(25000000UL, 12UL, &config));
+    expectUnchanged(synth, before);
+    
+    // A spacing the programmed frequency can follow is applied and retuned
+    SIM_CHECK(synth.setReferenceAutoHz(25000000UL, 1000UL, &config));
+    SIM_CHECK(config.pfdHz == synth.getPFDFrequencyHz());
+    SIM_CHECK(config.pfdHz != before.pfdHz);
+    expectOnFrequency(synth, 4390000000ULL, 1000UL);
+    
+    // Before anything is programmed there is nothing to check against
+    ADF4351 fresh(SIM_LE_PIN);
+    fresh.beginHz(25000000UL);
+    SIM_CHECK(fresh.setReferenceCorrectionPpb(-1000000L));
+    SIM_CHECK(fresh.setReferenceAutoHz(25000000UL, 12UL));
+    SIM_CHECK(!fresh.setFrequencyHz(4390000000ULL, 12UL));
+    
+    return simFinish("correction");
+}
@@ -0,0 +1,110 @@
+/*
+ * check_fsk.cpp - FSK symbol streams against the chip model
+ *
+ * Each symbol must leave the chip on the mark or space word with nothing
+ * else touched, repeated symbols must not write, the driver's frequency
+ * must follow the tone sent, runSymbols() must keep to the symbol clock,
+ * and any retune or settings change must end the stream.
+ */
+
+#include "ADF4351.h"
+#include "sim.h"
+
+static const uint8_t fsk[] = {0xA5, 0x0F, 0xC3};
+
+static uint8_t bitAt(const uint8_t *bits, uint32_t n) {
+    return (bits[n >> 3] >> (7 - (n & 7))) & 1;
+}
+
+// The stream is gone: no symbol is sent and the chip keeps its words
+static void expectStopped(ADF4351 &synth) {
+    uint32_t words = simChip.words;
+    uint32_t r0 = simChip.reg[0];
+    SIM_CHECK(!synth.symbolStep());
+    SIM_CHECK(!synth.runSymbols(1200));
+    SIM_CHECK(simChip.words == words);
+    SIM_CHECK(simChip.reg[0] == r0);
+    SIM_CHECK(synth.verifyRegisters());
+}
+
+int main() {
+    ADF4351 synth(SIM_LE_PIN);
+    ADF4351 reference(SIM_LE_PIN);
+    synth.beginHz(25000000UL);
+    reference.beginHz(25000000UL);
+    
+    // Two-tone FSK: one R0 write per symbol change
+    uint32_t mark[6];
+    uint32_t space[6];
+    reference.computeRegistersHz(433925000ULL, 1000UL, mark);
+    reference.computeRegistersHz(433915000ULL, 1000UL, space);
+    SIM_CHECK(reference.setFrequencyHz(433925000ULL, 1000UL));
+    uint64_t markActualHz = reference.getActualFrequencyHz();
+    SIM_CHECK(reference.setFrequencyHz(433915000ULL, 1000UL));
+    uint64_t spaceActualHz = reference.getActualFrequencyHz();
+    SIM_CHECK(synth.prepareFskHz(433925000ULL, 433915000ULL, fsk, 24, 1000UL));
+    SIM_CHECK(simChip.reg[0] == space[0]);
+    SIM_CHECK(synth.getFrequencyHz() == 433915000ULL);
+    
+    uint32_t words = simChip.words;
+    uint32_t changes = 0;
+    uint8_t last = 0;
+    for (uint32_t n = 0; n < 24; n++) {
+        uint8_t bit = bitAt(fsk, n);
+        changes += (bit != last);
+        last = bit;
+        SIM_CHECK(synth.symbolStep());
+        SIM_CHECK(simChip.reg[0] == (bit ? mark[0] : space[0]));
+        for (uint8_t i = 1; i < 6; i++) {
+            SIM_CHECK(simChip.reg[i] == space[i]);
+        }
+        
+        // The driver reports the tone on air
+        SIM_CHECK(synth.getFrequencyHz() == (bit ? 433925000ULL : 433915000ULL));
+        SIM_CHECK(synth.getActualFrequencyHz() == (bit ? markActualHz : spaceActualHz));
+        SIM_CHECK(synth.getActualFrequencyHz() == simOutputHz(25000000UL));
+        SIM_CHECK(synth.verifyRegisters());
+    }
+    SIM_CHECK(!synth.symbolStep());
+    SIM_CHECK(simChip.words - words == changes);
+    printf("FSK: 24 symbols, %u R0 writes\n", simChip.words - words);
+    
+    // Tones in different divider bands cannot share R4
+    SIM_CHECK(!synth.prepareFskHz(433925000ULL, 1000000000ULL, fsk, 24, 1000UL));
+    
+    ADF4351RampStats stats;
+    SIM_CHECK(synth.prepareFskHz(433925000ULL, 433915000ULL, fsk, 24, 1000UL));
+    SIM_CHECK(synth.runSymbols(1200, &stats));
+    SIM_CHECK(stats.steps == 24);
+    SIM_CHECK(stats.minIntervalUs >= 833 && stats.maxIntervalUs <= 834 + 20);
+    printf("FSK at 1200 baud: interval %u..%u us\n", stats.minIntervalUs, stats.maxIntervalUs);
+    
+    // A retune ends the stream: a later symbol must not put a 433 MHz R0
+    // behind the 2.4 GHz divider
+    SIM_CHECK(synth.prepareFskHz(433925000ULL, 433915000ULL, fsk, 24, 1000UL));
+    SIM_CHECK(synth.symbolStep());
+    SIM_CHECK(synth.setFrequencyHz(2400000000ULL, 1000UL));
+    expectStopped(synth);
+    SIM_CHECK(simOutputHz(25000000UL) == 2400000000ULL);
+    
+    // So does every settings change; a new correction or reference moves
+    // both tones
+    SIM_CHECK(synth.prepareFskHz(433925000ULL, 433915000ULL, fsk, 24, 1000UL));
+    SIM_CHECK(synth.setReferenceCorrectionPpb(20000));
+    expectStopped(synth);
+    SIM_CHECK(synth.prepareFskHz(433925000ULL, 433915000ULL, fsk, 24, 1000UL));
+    synth.setReferenceHz(25000000UL, 2);
+    SIM_CHECK(!synth.symbolStep());
+    SIM_CHECK(synth.prepareFskHz(433925000ULL, 433915000ULL, fsk, 24, 1000UL));
+    synth.setChargePumpCurrent(3);
+    SIM_CHECK(!synth.symbolStep());
+    SIM_CHECK(synth.prepareFskHz(433925000ULL, 433915000ULL, fsk, 24, 1000UL));
+    ADF4351HopEntry table[1];
+    table[0].freqHz = 2400000000ULL;
+    SIM_CHECK(synth.setHopTable(table, 1, 1000UL));
+    SIM_CHECK(synth.hopTo(0));
+    expectStopped(synth);
+    
+    printf("max symbol rate %u sym/s\n", (unsigned)ADF4351::getMaxSymbolRate());
+    return simFinish("fsk");
+}
@@ -0,0 +1,93 @@
+/*
+ * check_hop.cpp - hop tables against the chip model
+ *
+ * hopTo() must leave the chip on the words a full calculation gives, the
+ * table must reject frequencies outside 35 MHz - 4.4 GHz, and after a
+ * settings change each entry must be recomputed when it is next used,
+ * leaving the entries not yet used untouched.
+ */
+
+#include "ADF4351.h"
+#include "sim.h"
+
+static ADF4351 synth(SIM_LE_PIN);
+static ADF4351 plain(SIM_LE_PIN);
+static ADF4351HopEntry table[4];
+
+// Hop and compare the chip, the entry and the driver against a full calculation
+static void hop(uint16_t index) {
+    SIM_CHECK(synth.hopTo(index));
+    uint32_t regs[6];
+    SIM_CHECK(plain.computeRegistersHz(table[index].freqHz, 1000UL, regs));
+    for (uint8_t i = 0; i < 6; i++) {
+        SIM_CHECK(table[index].regs[i] == regs[i]);
+        SIM_CHECK(simChip.reg[i] == regs[i]);
+    }
+    SIM_CHECK(synth.verifyRegisters());
+    SIM_CHECK(synth.getFrequencyHz() == table[index].freqHz);
+    SIM_CHECK(synth.getActualFrequencyHz() == simOutputHz(25000000UL));
+}
+
+int main() {
+    synth.beginHz(25000000UL);
+    plain.beginHz(25000000UL);
+    const uint64_t freqsHz[4] = {433920000ULL, 868300000ULL, 2402000000ULL, 2480000000ULL};
+    for (uint8_t n = 0; n < 4; n++) {
+        table[n].freqHz = freqsHz[n];
+    }
+    
+    // Range edges and bad indices
+    SIM_CHECK(!synth.hopTo(0));
+    table[3].freqHz = 34999999ULL;
+    SIM_CHECK(!synth.setHopTable(table, 4, 1000UL));
+    table[3].freqHz = 4400000001ULL;
+    SIM_CHECK(!synth.setHopTable(table, 4, 1000UL));
+    SIM_CHECK(!synth.hopTo(0));
+    table[3].freqHz = 35000000ULL;
+    SIM_CHECK(synth.setHopTable(table, 4, 1000UL));
+    table[3].freqHz = 4400000000ULL;
+    SIM_CHECK(synth.setHopTable(table, 4, 1000UL));
+    table[3].freqHz = freqsHz[3];
+    SIM_CHECK(synth.setHopTable(table, 4, 1000UL));
+    SIM_CHECK(!synth.hopTo(4));
+    
+    // Hops within a band write R0 only
+    hop(2);
+    uint32_t words = simChip.words;
+    hop(3);
+    SIM_CHECK(simChip.words - words == 1);
+    hop(0);
+    hop(1);
+    
+    // A settings change marks every entry stale, but only the entry used
+    // is recomputed
+    uint16_t generation[4];
+    for (uint8_t n = 0; n < 4; n++) {
+        generation[n] = table[n].generation;
+    }
+    synth.setChargePumpCurrent(3);
+    plain.setChargePumpCurrent(3);
+    hop(2);
+    SIM_CHECK(table[2].generation != generation[2]);
+    SIM_CHECK(table[0].generation == generation[0]);
+    SIM_CHECK(table[3].generation == generation[3]);
+    hop(3);
+    SIM_CHECK(table[3].generation == table[2].generation);
+    
+    // The same for output power and a new reference path
+    synth.setOutputPower(1);
+    plain.setOutputPower(1);
+    hop(0);
+    synth.setReferenceHz(25000000UL, 5, 1, 0);
+    plain.setReferenceHz(25000000UL, 5, 1, 0);
+    for (uint8_t n = 0; n < 4; n++) {
+        hop(n);
+    }
+    
+    // Once refreshed, an entry is reused without recomputing
+    uint16_t refreshed = table[1].generation;
+    hop(1);
+    SIM_CHECK(table[1].generation == refreshed);
+    
+    return simFinish("hop");
+}
@@ -0,0 +1,124 @@
+/*
+ * check_lockhist.cpp - lock time histograms against the lock detect model
+ *
+ * Lock times must land in their band's log2 bucket, percentiles must
+ * report the bucket edges, lock spikes and timeouts must be flagged and
+ * nothing else, and a bucket about to overflow must halve its band.
+ */
+
+#include "ADF4351.h"
+#include "sim.h"
+
+// One output divider band per frequency, each with its own lock time
+static const uint64_t bandHz[3] = {3000000000ULL, 1500000000ULL, 433920000ULL};
+static const uint8_t bandSelect[3] = {0, 1, 3};
+static const uint32_t bandLockUs[3] = {40, 100, 300};
+static const uint8_t bandBucket[3] = {5, 6, 8};
+
+static const uint32_t spikeLockUs = 3000;
+static const uint8_t spikeBucket = 11;
+
+static bool hop(ADF4351 &synth, uint64_t freqHz, uint32_t lockUs) {
+    simLockUs = lockUs;
+    SIM_CHECK(synth.setFrequencyHz(freqHz));
+    return synth.waitForLock(SIM_LD_PIN, 5000);
+}
+
+static uint32_t total(const uint16_t counts[ADF4351_LOCK_BUCKETS]) {
+    uint32_t sum = 0;
+    for (uint8_t b = 0; b < ADF4351_LOCK_BUCKETS; b++) {
+        sum += counts[b];
+    }
+    return sum;
+}
+
+int main() {
+    ADF4351 synth(SIM_LE_PIN);
+    synth.beginHz(25000000UL);
+    uint16_t counts[ADF4351_LOCK_BUCKETS];
+    SIM_CHECK(!synth.getLockHistogram(7, counts));
+    SIM_CHECK(synth.getLockTimePercentileUs(0, 50) == 0);
+    SIM_CHECK(synth.getLockAnomalyCount() == 0);
+    
+    // 2000 hops over three bands with 9 lock spikes after the warm-up,
+    // three per band
+    const uint16_t spikes[9] = {402, 555, 700, 901, 1000, 1235, 1500, 1502, 1802};
+    uint16_t spikeCount[3] = {0, 0, 0};
+    uint16_t hopCount[3] = {0, 0, 0};
+    uint8_t next = 0;
+    for (uint16_t n = 0; n < 2000; n++) {
+        uint8_t band = n % 3;
+        bool spike = (next < 9 && spikes[next] == n);
+        next += spike;
+        SIM_CHECK(hop(synth, bandHz[band], spike ? spikeLockUs : bandLockUs[band]));
+        SIM_CHECK(synth.wasLastLockAnomalous() == spike);
+        hopCount[band]++;
+        spikeCount[band] += spike;
+    }
+    SIM_CHECK(synth.getLockAnomalyCount() == 9);
+    
+    for (uint8_t band = 0; band < 3; band++) {
+        uint8_t select = bandSelect[band];
+        SIM_CHECK(synth.getLockHistogram(select, counts));
+        SIM_CHECK(total(counts) == hopCount[band]);
+        SIM_CHECK(counts[bandBucket[band]] == hopCount[band] - spikeCount[band]);
+        SIM_CHECK(counts[spikeBucket] == spikeCount[band]);
+        
+        // Percentiles report the upper edge of the bucket holding them
+        SIM_CHECK(synth.getLockTimePercentileUs(select, 1) == 2UL << bandBucket[band]);
+        SIM_CHECK(synth.getLockTimePercentileUs(select, 99) == 2UL << bandBucket[band]);
+        SIM_CHECK(synth.getLockTimePercentileUs(select, 100) == 2UL << spikeBucket);
+        SIM_CHECK(bandLockUs[band] < synth.getLockTimePercentileUs(select, 50));
+        printf("band %u: %u hops, %u spikes, p50 %u us, p100 %u us\n", select, hopCount[band],
+               spikeCount[band], synth.getLockTimePercentileUs(select, 50),
+               synth.getLockTimePercentileUs(select, 100));
+    }
+    SIM_CHECK(synth.getLockHistogram(2, counts));
+    SIM_CHECK(total(counts) == 0);
+    
+    // A lower percentile flags more: at the 50th the typical bucket is
+    // still in, a bucket above it is not
+    synth.setLockAnomalyPercentile(50);
+    SIM_CHECK(hop(synth, bandHz[0], bandLockUs[0]));
+    SIM_CHECK(!synth.wasLastLockAnomalous());
+    SIM_CHECK(hop(synth, bandHz[0], 2 * bandLockUs[0]));
+    SIM_CHECK(synth.wasLastLockAnomalous());
+    SIM_CHECK(synth.getLockAnomalyCount() == 10);
+    synth.setLockAnomalyPercentile(99);
+    
+    // A timeout is flagged and counted, and is not a lock time
+    SIM_CHECK(synth.getLockHistogram(bandSelect[1], counts));
+    uint32_t before = total(counts);
+    SIM_CHECK(!hop(synth, bandHz[1], 10000));
+    SIM_CHECK(synth.wasLastLockAnomalous());
+    SIM_CHECK(synth.getLockAnomalyCount() == 11);
+    SIM_CHECK(synth.getLockHistogram(bandSelect[1], counts));
+    SIM_CHECK(total(counts) == before);
+    SIM_CHECK(hop(synth, bandHz[1], bandLockUs[1]));
+    SIM_CHECK(!synth.wasLastLockAnomalous());
+    
+    // Clearing drops the histograms and the anomalies
+    synth.clearLockHistogram();
+    SIM_CHECK(synth.getLockAnomalyCount() == 0);
+    SIM_CHECK(!synth.wasLastLockAnomalous());
+    for (uint8_t select = 0; select < 7; select++) {
+        SIM_CHECK(synth.getLockHistogram(select, counts));
+        SIM_CHECK(total(counts) == 0);
+    }
+    
+    // Overflow: the 65536th sample in a bucket halves the whole band first
+    for (uint8_t n = 0; n < 5; n++) {
+        hop(synth, bandHz[0], spikeLockUs);
+    }
+    for (uint32_t n = 0; n < 70000; n++) {
+        hop(synth, bandHz[0], bandLockUs[0]);
+    }
+    SIM_CHECK(synth.getLockHistogram(bandSelect[0], counts));
+    SIM_CHECK(counts[bandBucket[0]] == 32768 + (70000 - 65536));
+    SIM_CHECK(counts[spikeBucket] == 2);
+    SIM_CHECK(total(counts) == 32768 + (70000 - 65536) + 2);
+    SIM_CHECK(synth.getLockTimePercentileUs(bandSelect[0], 99) == 2UL << bandBucket[0]);
+    printf("after 70005 hops in band 0: %u + %u samples\n", counts[bandBucket[0]], counts[spikeBucket]);
+    
+    return simFinish("lockhist");
+}
@@ -0,0 +1,64 @@
+/*
+ * check_measure.cpp - pipelined sweep-and-measure against the chip model
+ *
+ * At every sample the chip must already synthesize the frequency being
+ * measured. The detector stand-in is a 2.4 GHz bandpass response.
+ */
+
+#include "ADF4351.h"
+#include "sim.h"
+
+static ADF4351 synth(SIM_LE_PIN);
+static uint32_t mismatches = 0;
+
+static uint16_t detector(uint64_t freqHz) {
+    if (simOutputHz(25000000UL) != synth.getActualFrequencyHz()) {
+        mismatches++;
+    }
+    simMicros += 10;
+    double offset = ((double)freqHz - 2.4e9) / 20e6;
+    return (uint16_t)(4095 / (1 + offset * offset));
+}
+
+int main() {
+    synth.beginHz(25000000UL);
+    uint16_t results[401];
+    ADF4351RampStats stats;
+    
+    uint16_t locked = synth.measureSweepHz(2300000000ULL, 500000L, 401, results, detector, SIM_LD_PIN,
+                                           10, 1000, 10000UL, &stats);
+    SIM_CHECK(locked == 401);
+    SIM_CHECK(stats.steps == 401);
+    SIM_CHECK(mismatches == 0);
+    SIM_CHECK(results[200] == 4095);
+    printf("lock detect: %.0f steps/s, interval %u..%u us\n",
+           stats.steps * 1e6 / stats.elapsedUs, stats.minIntervalUs, stats.maxIntervalUs);
+    
+    locked = synth.measureSweepHz(2300000000ULL, 500000L, 401, results, detector, -1,
+                                  10, 100, 10000UL, &stats);
+    SIM_CHECK(locked == 401);
+    SIM_CHECK(mismatches == 0);
+    printf("fixed 100 us dwell: %.0f steps/s\n", stats.steps * 1e6 / stats.elapsedUs);
+    
+    // A loop that never locks still measures every step
+    simLockUs = 5000;
+    locked = synth.measureSweepHz(2300000000ULL, 500000L, 10, results, detector, SIM_LD_PIN,
+                                  10, 200, 10000UL, &stats);
+    SIM_CHECK(locked == 0);
+    SIM_CHECK(stats.steps == 10);
+    simLockUs = 40;
+    
+    // Stops at the top of the range
+    locked = synth.measureSweepHz(4390000000ULL, 5000000L, 10, results, detector, SIM_LD_PIN,
+                                  10, 1000, 10000UL, &stats);
+    SIM_CHECK(stats.steps == 3);
+    
+    // Downward across the 2.2 GHz divider boundary
+    locked = synth.measureSweepHz(2210000000ULL, -1000000L, 20, results, detector, SIM_LD_PIN,
+                                  10, 1000, 10000UL, &stats);
+    SIM_CHECK(locked == 20);
+    SIM_CHECK(mismatches == 0);
+    SIM_CHECK(synth.verifyRegisters());
+    
+    return simFinish("measure");
+}
@@ -0,0 +1,104 @@
+/*
+ * check_ook.cpp - OOK symbol streams against the chip model
+ *
+ * Each symbol must switch only the RF output enable in R4 (plus
+ * mute-till-lock when asked), a frequency update must restore R4, keying
+ * while asleep must keep the VCO down, and any retune or settings change
+ * must end the stream before it can write an R4 built for other settings.
+ */
+
+#include "ADF4351.h"
+#include "sim.h"
+
+static const uint8_t ook[] = {0xB2, 0x00, 0xFF, 0x5A};
+
+static uint8_t bitAt(const uint8_t *bits, uint32_t n) {
+    return (bits[n >> 3] >> (7 - (n & 7))) & 1;
+}
+
+// The stream is gone: no symbol is sent and the chip keeps its words
+static void expectStopped(ADF4351 &synth) {
+    uint32_t words = simChip.words;
+    uint32_t r4 = simChip.reg[4];
+    SIM_CHECK(!synth.symbolStep());
+    SIM_CHECK(!synth.symbolStep());
+    SIM_CHECK(!synth.runSymbols(1200));
+    SIM_CHECK(simChip.words == words);
+    SIM_CHECK(simChip.reg[4] == r4);
+}
+
+int main() {
+    // OOK: RF output enable in R4, optionally muted until lock
+    ADF4351 keyer(SIM_LE_PIN);
+    keyer.beginHz(25000000UL);
+    SIM_CHECK(!keyer.prepareOok(ook, 32));
+    SIM_CHECK(keyer.setFrequencyHz(433920000ULL));
+    uint32_t r0 = simChip.reg[0];
+    uint32_t r4 = simChip.reg[4];
+    const uint32_t keyBits = (1UL << 5) | (1UL << 10);
+    
+    SIM_CHECK(keyer.prepareOok(ook, 32, true));
+    SIM_CHECK(!(simChip.reg[4] & (1UL << 5)));
+    SIM_CHECK(simChip.reg[4] & (1UL << 10));
+    for (uint32_t n = 0; n < 32; n++) {
+        SIM_CHECK(keyer.symbolStep());
+        SIM_CHECK(((simChip.reg[4] >> 5) & 1) == bitAt(ook, n));
+        SIM_CHECK((simChip.reg[4] & ~keyBits) == (r4 & ~keyBits));
+        SIM_CHECK(simChip.reg[0] == r0);
+    }
+    SIM_CHECK(!keyer.symbolStep());
+    
+    // A frequency update restores R4; keying while asleep keeps the VCO down
+    SIM_CHECK(keyer.setFrequencyHz(433920000ULL));
+    SIM_CHECK(simChip.reg[4] == r4);
+    SIM_CHECK(keyer.verifyRegisters());
+    keyer.sleep();
+    SIM_CHECK(keyer.prepareOok(ook, 32));
+    keyer.symbolStep();
+    keyer.symbolStep();
+    SIM_CHECK(simChip.reg[4] & (1UL << 11));
+    keyer.wake();
+    SIM_CHECK(keyer.setFrequencyHz(433920000ULL));
+    SIM_CHECK(simChip.reg[4] == r4);
+    
+    // A retune to another band ends the stream: the next symbols must not
+    // put the 2.4 GHz divider back behind a 1 GHz R0
+    SIM_CHECK(keyer.setFrequencyHz(2400000000ULL));
+    SIM_CHECK(keyer.prepareOok(ook, 32));
+    SIM_CHECK(keyer.symbolStep());
+    SIM_CHECK(keyer.setFrequencyHz(1000000000ULL));
+    uint32_t r4At1GHz = simChip.reg[4];
+    expectStopped(keyer);
+    SIM_CHECK(simChip.reg[4] == r4At1GHz);
+    SIM_CHECK(simOutputHz(25000000UL) == 1000000000ULL);
+    SIM_CHECK(keyer.verifyRegisters());
+    
+    // Output power lives in R4 too: a stale word would undo the change
+    SIM_CHECK(keyer.prepareOok(ook, 32));
+    SIM_CHECK(keyer.symbolStep());
+    keyer.setOutputPower(0);
+    expectStopped(keyer);
+    SIM_CHECK(keyer.setFrequencyHz(1000000000ULL));
+    SIM_CHECK(((simChip.reg[4] >> 3) & 3) == 0);
+    
+    // And the other paths that program new registers
+    SIM_CHECK(keyer.prepareOok(ook, 32));
+    keyer.setReferenceHz(25000000UL, 2);
+    expectStopped(keyer);
+    SIM_CHECK(keyer.setFrequencyHz(1000000000ULL));
+    SIM_CHECK(keyer.prepareOok(ook, 32));
+    SIM_CHECK(keyer.setReferenceCorrectionPpb(-3000));
+    expectStopped(keyer);
+    ADF4351HopEntry table[1];
+    table[0].freqHz = 2400000000ULL;
+    SIM_CHECK(keyer.setHopTable(table, 1));
+    SIM_CHECK(keyer.prepareOok(ook, 32));
+    SIM_CHECK(keyer.hopTo(0));
+    expectStopped(keyer);
+    uint32_t ramp[4];
+    SIM_CHECK(keyer.prepareOok(ook, 32));
+    SIM_CHECK(keyer.prepareRampHz(2400000000ULL, 2403000000ULL, 4, ramp));
+    expectStopped(keyer);
+    
+    return simFinish("ook");
+}
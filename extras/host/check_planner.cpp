@@ -0,0 +1,129 @@
+/*
+ * check_planner.cpp - planReferenceHz() against an exhaustive search
+ *
+ * For each channel plan the chosen R / doubler / divide-by-2 must hit as
+ * many entries in integer-N as any legal configuration, with the highest
+ * PFD among those, and the hop table must come out loaded and exact.
+ */
+
+#include "ADF4351.h"
+#include "sim.h"
+
+// Entries that one configuration synthesizes exactly with FRAC = 0, or -1
+// if the configuration is not legal for the plan
+static int integerEntries(uint32_t refHz, uint8_t r, uint8_t d, uint8_t t,
+                          const uint64_t *freqsHz, uint16_t count, uint32_t spacingHz) {
+    if (d && refHz > 30000000UL) {
+        return -1;
+    }
+    uint64_t num = (uint64_t)refHz * (1 + d);
+    uint64_t den = (uint64_t)r * (1 + t);
+    if (num > 45000000ULL * den) {
+        return -1;
+    }
+    
+    ADF4351 scratch(SIM_LE_PIN);
+    scratch.setReferenceHz(refHz, r, d, t);
+    int hits = 0;
+    for (uint16_t n = 0; n < count; n++) {
+        uint32_t regs[6];
+        if (!scratch.computeRegistersHz(freqsHz[n], spacingHz, regs)) {
+            return -1;
+        }
+        ADF4351RegisterInfo info;
+        ADF4351::decodeRegisters(regs, info);
+        if (info.fracValue == 0 && ADF4351::calcOutputFrequencyHz(info, refHz) == freqsHz[n]) {
+            hits++;
+        }
+    }
+    
+    // Fractional-N limits apply as soon as one entry needs FRAC
+    if (hits < count && (num > 32000000ULL * den || num > 4095ULL * den * spacingHz)) {
+        return -1;
+    }
+    return hits;
+}
+
+static void plan(const char *label, uint32_t refHz, const uint64_t *freqsHz, uint16_t count, uint32_t spacingHz) {
+    // Exhaustive search: most integer entries, then highest PFD
+    int bestHits = -1;
+    uint64_t bestNum = 0;
+    uint64_t bestDen = 1;
+    for (uint8_t d = 0; d <= 1; d++) {
+        for (uint8_t t = 0; t <= 1; t++) {
+            for (uint16_t r = 1; r <= 255; r++) {
+                int hits = integerEntries(refHz, (uint8_t)r, d, t, freqsHz, count, spacingHz);
+                uint64_t num = (uint64_t)refHz * (1 + d);
+                uint64_t den = (uint64_t)r * (1 + t);
+                if (hits > bestHits || (hits == bestHits && hits >= 0 && num * bestDen > bestNum * den)) {
+                    bestHits = hits;
+                    bestNum = num;
+                    bestDen = den;
+                }
+            }
+        }
+    }
+    
+    ADF4351 synth(SIM_LE_PIN);
+    synth.beginHz(refHz);
+    ADF4351HopEntry table[16];
+    for (uint16_t n = 0; n < count; n++) {
+        table[n].freqHz = freqsHz[n];
+    }
+    ADF4351ReferenceConfig config;
+    bool planned = synth.planReferenceHz(refHz, table, count, spacingHz, &config);
+    SIM_CHECK(planned == (bestHits >= 0));
+    if (!planned) {
+        return;
+    }
+    
+    uint64_t num = (uint64_t)refHz * (1 + config.refDoubler);
+    uint64_t den = (uint64_t)config.rCounter * (1 + config.refDiv2);
+    SIM_CHECK(config.integerNCount == bestHits);
+    SIM_CHECK(integerEntries(refHz, config.rCounter, config.refDoubler, config.refDiv2,
+                             freqsHz, count, spacingHz) == bestHits);
+    SIM_CHECK(num * bestDen == bestNum * den);
+    SIM_CHECK(config.pfdHz == synth.getPFDFrequencyHz());
+    SIM_CHECK(config.mod <= 4095);
+    SIM_CHECK(config.integerNCount == count || num <= 32000000ULL * den);
+    
+    // The table is loaded: every hop lands within half a channel
+    for (uint16_t n = 0; n < count; n++) {
+        SIM_CHECK(synth.hopTo(n));
+        uint64_t outHz = simOutputHz(refHz);
+        uint64_t errorHz = (outHz > freqsHz[n]) ? outHz - freqsHz[n] : freqsHz[n] - outHz;
+        SIM_CHECK(errorHz <= spacingHz / 2 + 1);
+    }
+    printf("%s: R=%u D=%u T=%u, PFD %u Hz, %u of %u integer-N\n", label, config.rCounter,
+           config.refDoubler, config.refDiv2, config.pfdHz, config.integerNCount, count);
+}
+
+int main() {
+    // A 5 MHz raster from 25 MHz: all integer-N at a 5 MHz PFD
+    const uint64_t raster[] = {2400000000ULL, 2405000000ULL, 2410000000ULL, 2415000000ULL,
+                               2420000000ULL, 2435000000ULL, 2440000000ULL, 2480000000ULL};
+    plan("5 MHz raster", 25000000UL, raster, 8, 1000000UL);
+    
+    // Channels across divider bands
+    const uint64_t bands[] = {145800000ULL, 435000000ULL, 1296000000ULL, 2320000000ULL, 3400000000ULL};
+    plan("amateur bands", 10000000UL, bands, 5, 12500UL);
+    
+    // A mixed plan that cannot be all integer-N keeps to the fractional limits
+    const uint64_t mixed[] = {433920000ULL, 868300000ULL, 915000000ULL, 2402000000ULL, 2441750000ULL};
+    plan("ISM mix, 25 MHz", 25000000UL, mixed, 5, 1000UL);
+    plan("ISM mix, 122.88 MHz", 122880000UL, mixed, 5, 1000UL);
+    plan("ISM mix, 10 MHz", 10000000UL, mixed, 5, 250UL);
+    
+    // An entry out of range is refused and the reference is left alone
+    ADF4351 synth(SIM_LE_PIN);
+    synth.beginHz(25000000UL);
+    ADF4351HopEntry table[2];
+    table[0].freqHz = 2400000000ULL;
+    table[1].freqHz = 30000000ULL;
+    uint32_t pfdHz = synth.getPFDFrequencyHz();
+    SIM_CHECK(!synth.planReferenceHz(25000000UL, table, 2, 1000UL));
+    SIM_CHECK(synth.getPFDFrequencyHz() == pfdHz);
+    SIM_CHECK(!synth.hopTo(0));
+    
+    return simFinish("planner");
+}
@@ -0,0 +1,107 @@
+/*
+ * check_ramp.cpp - prepared FMCW ramps against the chip model
+ *
+ * Each step must leave the chip on the precomputed R0 word for that
+ * point, sawtooth and triangle must visit the points in order, and any
+ * retune or settings change must drop the ramp so a later step cannot
+ * write a word computed for the old registers.
+ */
+
+#include "ADF4351.h"
+#include "sim.h"
+
+static uint32_t buffer[11];
+
+// Prepare a 2.4005-2.4105 GHz ramp and check the chip after one step
+static void prepare(ADF4351 &synth, ADF4351RampShape shape = ADF4351_RAMP_SAWTOOTH) {
+    SIM_CHECK(synth.prepareRampHz(2400500000ULL, 2410500000ULL, 11, buffer, shape, 1000UL));
+    SIM_CHECK(simChip.reg[0] == buffer[0]);
+    synth.rampStep();
+    SIM_CHECK(simChip.reg[0] == buffer[1]);
+}
+
+// The ramp is gone: stepping writes nothing and the chip keeps its words
+static void expectStopped(ADF4351 &synth) {
+    uint32_t words = simChip.words;
+    uint32_t regs[6];
+    for (uint8_t i = 0; i < 6; i++) {
+        regs[i] = simChip.reg[i];
+    }
+    synth.rampStep();
+    SIM_CHECK(!synth.runRamp(10, 5));
+    SIM_CHECK(simChip.words == words);
+    for (uint8_t i = 0; i < 6; i++) {
+        SIM_CHECK(simChip.reg[i] == regs[i]);
+    }
+}
+
+int main() {
+    ADF4351 synth(SIM_LE_PIN);
+    ADF4351 reference(SIM_LE_PIN);
+    synth.beginHz(25000000UL);
+    reference.beginHz(25000000UL);
+    
+    // Every point is the R0 of a full calculation, with R1..R5 shared
+    SIM_CHECK(synth.prepareRampHz(2400500000ULL, 2410500000ULL, 11, buffer, ADF4351_RAMP_SAWTOOTH, 1000UL));
+    for (uint8_t k = 0; k < 11; k++) {
+        uint32_t regs[6];
+        SIM_CHECK(reference.computeRegistersHz(2400500000ULL + 1000000ULL * k, 1000UL, regs));
+        SIM_CHECK(buffer[k] == regs[0]);
+        for (uint8_t i = 1; i < 6; i++) {
+            SIM_CHECK(simChip.reg[i] == regs[i]);
+        }
+    }
+    
+    // Sawtooth wraps to the start, triangle turns at both ends
+    for (uint8_t n = 1; n <= 22; n++) {
+        synth.rampStep();
+        SIM_CHECK(simChip.reg[0] == buffer[n % 11]);
+    }
+    SIM_CHECK(synth.prepareRampHz(2400500000ULL, 2410500000ULL, 11, buffer, ADF4351_RAMP_TRIANGLE, 1000UL));
+    const uint8_t path[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 1};
+    for (uint8_t n = 0; n < sizeof(path); n++) {
+        synth.rampStep();
+        SIM_CHECK(simChip.reg[0] == buffer[path[n]]);
+    }
+    
+    // Ramps that cross a divider band cannot share R4
+    SIM_CHECK(!synth.prepareRampHz(2150000000ULL, 2250000000ULL, 11, buffer, ADF4351_RAMP_SAWTOOTH, 1000UL));
+    expectStopped(synth);
+    
+    // A retune to another band drops the ramp: stepping must not put a
+    // 2.4 GHz R0 behind the 1 GHz divider
+    prepare(synth);
+    SIM_CHECK(synth.setFrequencyHz(1000000000ULL, 1000UL));
+    expectStopped(synth);
+    SIM_CHECK(simOutputHz(25000000UL) == 1000000000ULL);
+    
+    // So do the other paths that program new registers
+    ADF4351HopEntry table[1];
+    table[0].freqHz = 1000000000ULL;
+    SIM_CHECK(synth.setHopTable(table, 1, 1000UL));
+    prepare(synth);
+    SIM_CHECK(synth.hopTo(0));
+    expectStopped(synth);
+    
+    const uint8_t bits[] = {0x55};
+    prepare(synth);
+    SIM_CHECK(synth.prepareFskHz(433925000ULL, 433915000ULL, bits, 8, 1000UL));
+    expectStopped(synth);
+    
+    // And every settings change, even one that leaves R0 alone
+    prepare(synth);
+    synth.setReferenceHz(25000000UL, 2);
+    expectStopped(synth);
+    synth.setReferenceHz(25000000UL);
+    prepare(synth);
+    synth.setOutputPower(1);
+    expectStopped(synth);
+    prepare(synth);
+    synth.setChargePumpCurrent(3);
+    expectStopped(synth);
+    prepare(synth);
+    SIM_CHECK(synth.setReferenceCorrectionPpb(1000));
+    expectStopped(synth);
+    
+    return simFinish("ramp");
+}
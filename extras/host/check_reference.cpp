@@ -0,0 +1,83 @@
+/*
+ * check_reference.cpp - automatic reference configuration limits
+ *
+ * The chosen PFD must stay within 32 MHz (fractional-N) or 45 MHz
+ * (integer-N, with the 3 ns anti-backlash pulse above 32 MHz), and no
+ * programmed word may use the 4/5 prescaler above a 3.6 GHz VCO.
+ */
+
+#include "ADF4351.h"
+#include "sim.h"
+
+static void checkPrescaler(const ADF4351 &synth) {
+    ADF4351RegisterInfo info;
+    synth.getRegisterInfo(info);
+    uint64_t vcoHz = synth.getActualFrequencyHz() * info.outputDivider;
+    SIM_CHECK(info.prescaler == 1 || vcoHz <= 3600000000ULL);
+    SIM_CHECK(info.intValue >= (info.prescaler ? 75 : 23));
+}
+
+int main() {
+    const uint32_t refs[] = {10000000UL, 25000000UL, 40000000UL, 80000000UL, 100000000UL, 122880000UL};
+    const uint32_t spacings[] = {1000UL, 10000UL, 100000UL, 1000000UL, 5000000UL, 40000000UL, 80000000UL};
+    
+    for (uint8_t r = 0; r < sizeof(refs) / sizeof(refs[0]); r++) {
+        for (uint8_t s = 0; s < sizeof(spacings) / sizeof(spacings[0]); s++) {
+            ADF4351 synth(SIM_LE_PIN);
+            synth.beginHz(refs[r]);
+            ADF4351ReferenceConfig config;
+            if (!synth.setReferenceAutoHz(refs[r], spacings[s], &config)) {
+                continue;
+            }
+            SIM_CHECK(config.pfdHz <= (config.integerN ? 45000000UL : 32000000UL));
+            
+            for (uint64_t freqHz = 35000000ULL; freqHz <= 4400000000ULL; freqHz += 7770000ULL) {
+                uint64_t channelHz = freqHz / spacings[s] * spacings[s];
+                if (!synth.setFrequencyHz(channelHz, spacings[s])) {
+                    continue;
+                }
+                checkPrescaler(synth);
+                
+                // Anti-backlash 3 ns and charge cancel only for integer-N above 32 MHz
+                ADF4351RegisterInfo info;
+                synth.getRegisterInfo(info);
+                bool fast = info.fracValue == 0 && config.pfdHz > 32000000UL;
+                SIM_CHECK(info.antiBacklash == fast);
+                SIM_CHECK(info.chargeCancel == fast);
+            }
+        }
+    }
+    
+    // 80 MHz integer-N spacing: the PFD is halved to 40 MHz and 4 GHz uses 8/9
+    ADF4351 synth(SIM_LE_PIN);
+    synth.beginHz(80000000UL);
+    ADF4351ReferenceConfig config;
+    SIM_CHECK(synth.setReferenceAutoHz(80000000UL, 80000000UL, &config));
+    SIM_CHECK(config.pfdHz == 40000000UL);
+    SIM_CHECK(synth.setFrequencyHz(4000000000ULL, 80000000UL));
+    checkPrescaler(synth);
+    ADF4351RegisterInfo info;
+    synth.getRegisterInfo(info);
+    SIM_CHECK(info.antiBacklash == 1);
+    
+    // A manual 100 MHz PFD cannot reach the upper VCO range
+    synth.setReferenceHz(100000000UL);
+    SIM_CHECK(!synth.setFrequencyHz(4000000000ULL, 100000000UL));
+    SIM_CHECK(synth.setFrequencyHz(3500000000ULL, 100000000UL));
+    checkPrescaler(synth);
+    
+    // The batch path sets R3 the same way
+    const uint64_t freqs[] = {2400000000ULL, 2400010000ULL, 4000000000ULL};
+    ADF4351RegisterSet out[3];
+    synth.setReferenceHz(40000000UL);
+    SIM_CHECK(synth.computeRegistersHz(freqs, 3, out, 10000UL) == 3);
+    for (uint8_t n = 0; n < 3; n++) {
+        uint32_t regs[6];
+        SIM_CHECK(synth.computeRegistersHz(freqs[n], 10000UL, regs));
+        for (uint8_t i = 0; i < 6; i++) {
+            SIM_CHECK(out[n].reg[i] == regs[i]);
+        }
+    }
+    
+    return simFinish("reference");
+}
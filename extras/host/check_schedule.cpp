@@ -0,0 +1,171 @@
+/*
+ * check_schedule.cpp - time-tagged commands against a simulated timer
+ *
+ * Commands must fire in time order (equal times in scheduling order),
+ * leave the chip holding the shadow registers, pick up settings changed
+ * between scheduling and firing, and wait for a register write in progress
+ * when serviced from an interrupt.
+ */
+
+#include "ADF4351.h"
+#include "sim.h"
+
+// Timer interrupt taken between SPI bytes
+static ADF4351 *timerSynth = NULL;
+static uint32_t timerCalls = 0;
+static uint32_t timerFired = 0;
+
+static void timerInterrupt() {
+    timerCalls++;
+    timerFired += timerSynth->serviceSchedule();
+}
+
+int main() {
+    ADF4351 synth(SIM_LE_PIN);
+    synth.beginHz(25000000UL);
+    SIM_CHECK(synth.setFrequencyHz(1000000000ULL));
+    
+    ADF4351TimedCommand queue[8];
+    synth.setScheduleQueue(queue, 8);
+    
+    uint32_t t0 = simMicros + 1000;
+    SIM_CHECK(synth.scheduleFrequencyHz(t0 + 3000, 2000000000ULL));
+    SIM_CHECK(synth.scheduleOutputPower(t0 + 1000, 1));
+    SIM_CHECK(synth.scheduleFrequencyHz(t0 + 2000, 1500000000ULL));
+    SIM_CHECK(synth.scheduleOutputEnable(t0 + 4000, false));
+    SIM_CHECK(synth.scheduleFrequencyHz(t0 + 2000, 1600000000ULL));
+    SIM_CHECK(!synth.scheduleFrequencyHz(t0, 10));
+    SIM_CHECK(synth.getScheduledCount() == 5);
+    
+    uint32_t nextUs = 0;
+    SIM_CHECK(synth.getNextCommandTime(nextUs));
+    SIM_CHECK(nextUs == t0 + 1000);
+    
+    // Timer interrupt stand-in: service every simulated microsecond.
+    // Both t0 + 2000 commands fire in one call, the later-scheduled last.
+    uint64_t seen[4];
+    uint8_t seenCount = 0;
+    uint64_t lastHz = synth.getFrequencyHz();
+    while (synth.getScheduledCount() > 0) {
+        simMicros++;
+        if (synth.serviceSchedule() > 0 && synth.getFrequencyHz() != lastHz) {
+            lastHz = synth.getFrequencyHz();
+            if (seenCount < 4) seen[seenCount] = lastHz;
+            seenCount++;
+        }
+    }
+    SIM_CHECK(seenCount == 2);
+    SIM_CHECK(seen[0] == 1600000000ULL);
+    SIM_CHECK(seen[1] == 2000000000ULL);
+    for (uint8_t i = 0; i < 6; i++) {
+        SIM_CHECK(simChip.reg[i] == synth.getRegister(i));
+    }
+    
+    ADF4351RegisterInfo info;
+    synth.getRegisterInfo(info);
+    SIM_CHECK(info.outputPower == 1);
+    SIM_CHECK(info.rfOutputEnable == 0);
+    
+    ADF4351ScheduleStats stats;
+    synth.getScheduleStats(stats);
+    SIM_CHECK(stats.fired == 5);
+    SIM_CHECK(stats.rejected == 1);
+    printf("serviced: fired %u, late min %u mean %u max %u us\n",
+           stats.fired, stats.minLateUs, stats.meanLateUs, stats.maxLateUs);
+    
+    // Busy-wait runner; a charge pump change in between forces a recompute
+    synth.enableOutput(true);
+    synth.resetScheduleStats();
+    uint32_t t1 = simMicros + 500;
+    for (uint8_t k = 0; k < 6; k++) {
+        SIM_CHECK(synth.scheduleFrequencyHz(t1 + k * 250UL, 3000000000ULL + k * 1000000ULL));
+    }
+    synth.setChargePumpCurrent(3);
+    synth.setOutputPower(2);
+    SIM_CHECK(synth.scheduleFrequencyHz(t1 + 9999, 3000000000ULL));
+    SIM_CHECK(synth.scheduleFrequencyHz(t1 + 9999, 3100000000ULL));
+    SIM_CHECK(!synth.scheduleFrequencyHz(t1 + 9999, 3200000000ULL));
+    
+    SIM_CHECK(synth.runSchedule() == 8);
+    synth.getScheduleStats(stats);
+    SIM_CHECK(stats.fired == 8);
+    SIM_CHECK(stats.rejected == 1);
+    SIM_CHECK(stats.recomputed == 6);
+    SIM_CHECK(synth.getFrequencyHz() == 3100000000ULL);
+    SIM_CHECK(synth.verifyRegisters());
+    for (uint8_t i = 0; i < 6; i++) {
+        SIM_CHECK(simChip.reg[i] == synth.getRegister(i));
+    }
+    printf("runSchedule: fired %u, recomputed %u, late min %u mean %u max %u us\n",
+           stats.fired, stats.recomputed, stats.minLateUs, stats.meanLateUs, stats.maxLateUs);
+    
+    // A command that can no longer be synthesized is dropped as rejected
+    synth.resetScheduleStats();
+    SIM_CHECK(synth.scheduleFrequencyHz(simMicros + 100, 4399000000ULL));
+    SIM_CHECK(synth.setReferenceCorrectionPpb(-1000000L));
+    uint32_t words = simChip.words;
+    SIM_CHECK(synth.runSchedule() == 0);
+    synth.getScheduleStats(stats);
+    SIM_CHECK(stats.fired == 0);
+    SIM_CHECK(stats.rejected == 1);
+    SIM_CHECK(synth.getScheduledCount() == 0);
+    SIM_CHECK(simChip.words == words);
+    
+    // Refusals are counted with interrupts left as they were
+    SIM_CHECK(!synth.scheduleFrequencyHz(simMicros, 20000000ULL));
+    synth.getScheduleStats(stats);
+    SIM_CHECK(stats.rejected == 2);
+    SIM_CHECK(simInterruptsEnabled);
+    
+    // A timer interrupt in the middle of a main-loop write must not put its
+    // words inside the one being clocked out: it is deferred and the command
+    // fires when the write ends
+    SIM_CHECK(synth.setReferenceCorrectionPpb(0));
+    synth.resetScheduleStats();
+    simBusReset();
+    SIM_CHECK(synth.scheduleFrequencyHz(simMicros, 2000000000ULL));
+    timerSynth = &synth;
+    simTransferHook = timerInterrupt;
+    SIM_CHECK(synth.setFrequencyHz(1000000000ULL));
+    simTransferHook = NULL;
+    SIM_CHECK(timerCalls > 0);
+    SIM_CHECK(timerFired == 0);
+    SIM_CHECK(synth.getScheduledCount() == 0);
+    synth.getScheduleStats(stats);
+    SIM_CHECK(stats.fired == 1);
+    SIM_CHECK(simBus.badWords == 0);
+    SIM_CHECK(synth.getFrequencyHz() == 2000000000ULL);
+    SIM_CHECK(simOutputHz(25000000UL) == 2000000000ULL);
+    SIM_CHECK(synth.verifyRegisters());
+    for (uint8_t i = 0; i < 6; i++) {
+        SIM_CHECK(simChip.reg[i] == synth.getRegister(i));
+    }
+    
+    // The same while the main loop services the schedule itself: the
+    // interrupt defers and the main loop's call applies everything due
+    synth.resetScheduleStats();
+    timerCalls = 0;
+    uint32_t t2 = simMicros + 100;
+    SIM_CHECK(synth.scheduleFrequencyHz(t2, 1500000000ULL));
+    SIM_CHECK(synth.scheduleOutputPower(t2 + 10, 3));
+    SIM_CHECK(synth.scheduleFrequencyHz(t2 + 20, 2500000000ULL));
+    simTransferHook = timerInterrupt;
+    SIM_CHECK(synth.runSchedule() == 3);
+    simTransferHook = NULL;
+    SIM_CHECK(timerCalls > 0);
+    SIM_CHECK(timerFired == 0);
+    synth.getScheduleStats(stats);
+    SIM_CHECK(stats.fired == 3);
+    SIM_CHECK(simBus.badWords == 0);
+    SIM_CHECK(simOutputHz(25000000UL) == 2500000000ULL);
+    SIM_CHECK(((simChip.reg[4] >> 3) & 3) == 3);
+    SIM_CHECK(synth.verifyRegisters());
+    
+    // With the bus free the interrupt fires the command itself
+    SIM_CHECK(synth.scheduleFrequencyHz(simMicros, 3000000000ULL));
+    timerInterrupt();
+    SIM_CHECK(timerFired == 1);
+    SIM_CHECK(simOutputHz(25000000UL) == 3000000000ULL);
+    
+    return simFinish("schedule");
+}
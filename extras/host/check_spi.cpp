@@ -0,0 +1,81 @@
+/*
+ * check_spi.cpp - serial interface timing against the bit-level bus model
+ *
+ * Every write the driver makes must meet the datasheet t1..t7 limits and
+ * be exactly 32 bits, and the model must flag a bus driven out of spec.
+ * Bus utilization is reported for a full update and for in-band hops,
+ * with an ideal LE pin and with a slow digitalWrite().
+ */
+
+#include "ADF4351.h"
+#include "sim.h"
+
+static void hops(ADF4351 &synth, const char *label) {
+    synth.setFrequencyHz(2401000000ULL);
+    simBusReset();
+    for (uint32_t n = 0; n < 1000; n++) {
+        SIM_CHECK(synth.setFrequencyHz((n & 1) ? 2401000000ULL : 2402000000ULL));
+    }
+    SIM_CHECK(simBusViolations() == 0);
+    SIM_CHECK(simBus.bits == 1000 * 32);
+    simBusReport(label);
+}
+
+int main() {
+    printf("SPI clock %lu Hz, LE delay %u us\n", (unsigned long)ADF4351_SPI_CLOCK_HZ, ADF4351_LE_DELAY_US);
+    
+    ADF4351 synth(SIM_LE_PIN);
+    synth.beginHz(25000000UL);
+    simBusReset();
+    SIM_CHECK(synth.setFrequencyHz(2400000000ULL));
+    SIM_CHECK(simBusViolations() == 0);
+    SIM_CHECK(simBus.bits == 6 * 32);
+    SIM_CHECK(simChip.latched == 0x3F);
+    for (uint8_t i = 0; i < 6; i++) {
+        SIM_CHECK(simChip.reg[i] == synth.getRegister(i));
+    }
+    simBusReport("full update");
+    
+    hops(synth, "R0 hops, ideal LE pin");
+    simGpioNs = 4000;
+    hops(synth, "R0 hops, 4 us digitalWrite");
+    simGpioNs = 0;
+    
+    // Sleep and wake share one transaction per burst
+    simBusReset();
+    uint32_t transactions = simChip.transactions;
+    synth.sleep();
+    synth.wake();
+    SIM_CHECK(simChip.transactions - transactions == 2);
+    SIM_CHECK(simBusViolations() == 0);
+    
+    // A 25 MHz clock breaks t4/t5, and re-lowering LE at once breaks t7
+    simBusReset();
+    uint32_t r0 = simChip.reg[0];
+    SPI.beginTransaction(SPISettings(25000000UL, MSBFIRST, SPI_MODE0));
+    digitalWrite(SIM_LE_PIN, LOW);
+    for (int8_t shift = 24; shift >= 0; shift -= 8) {
+        SPI.transfer((r0 >> shift) & 0xFF);
+    }
+    digitalWrite(SIM_LE_PIN, HIGH);
+    digitalWrite(SIM_LE_PIN, LOW);
+    SPI.endTransaction();
+    SIM_CHECK(simBus.violations[3] > 0);
+    SIM_CHECK(simBus.violations[4] > 0);
+    SIM_CHECK(simBus.violations[6] == 1);
+    SIM_CHECK(simBus.badWords == 0);
+    
+    // A short word is counted and not latched
+    uint32_t words = simChip.words;
+    SPI.beginTransaction(SPISettings(ADF4351_SPI_CLOCK_HZ, MSBFIRST, SPI_MODE0));
+    for (int8_t shift = 16; shift >= 0; shift -= 8) {
+        SPI.transfer((r0 >> shift) & 0xFF);
+    }
+    digitalWrite(SIM_LE_PIN, HIGH);
+    SPI.endTransaction();
+    SIM_CHECK(simBus.badWords == 1);
+    SIM_CHECK(simChip.words == words);
+    simBusReport("out of spec");
+    
+    return simFinish("spi");
+}
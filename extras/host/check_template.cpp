@@ -0,0 +1,132 @@
+/*
+ * check_template.cpp - ADF4351T against the runtime ADF4351
+ *
+ * The compile-time PFD must produce exactly the runtime words for every
+ * frequency, the reference must not be changeable behind it, warm starts
+ * must only accept a state saved with the same reference, and the
+ * benchmark compares the per-call time of the two.
+ */
+
+#include "ADF4351.h"
+#include "sim.h"
+#include <chrono>
+#include <type_traits>
+#include <utility>
+
+// beginHz() and setReferenceHz() would change the PFD behind computeFixed()
+template <class T, class = void>
+struct CanBeginHz : std::false_type {};
+template <class T>
+struct CanBeginHz<T, decltype(std::declval<T &>().beginHz(0u), void())> : std::true_type {};
+template <class T, class = void>
+struct CanSetReference : std::false_type {};
+template <class T>
+struct CanSetReference<T, decltype(std::declval<T &>().setReferenceHz(0u), void())> : std::true_type {};
+
+static_assert(CanBeginHz<ADF4351>::value && CanSetReference<ADF4351>::value, "runtime driver");
+static_assert(!CanBeginHz<ADF4351T<SIM_LE_PIN, 25000000UL> >::value, "beginHz() is hidden");
+static_assert(!CanSetReference<ADF4351T<SIM_LE_PIN, 25000000UL> >::value, "setReferenceHz() is hidden");
+
+template <class T>
+static void compare(T &fixed, uint32_t refHz, uint8_t r, uint8_t doubler, uint8_t div2) {
+    ADF4351 runtime(SIM_LE_PIN);
+    runtime.setReferenceHz(refHz, r, doubler, div2);
+    runtime.beginHz(refHz);
+    fixed.begin();
+    
+    const uint32_t spacings[] = {1000UL, 10000UL, 100000UL};
+    for (uint64_t freqHz = 35000000ULL; freqHz <= 4400000000ULL; freqHz += 1234567ULL) {
+        for (uint8_t s = 0; s < 3; s++) {
+            bool a = runtime.setFrequencyHz(freqHz, spacings[s]);
+            bool b = fixed.setFrequencyHz(freqHz, spacings[s]);
+            SIM_CHECK(a == b);
+            for (uint8_t i = 0; i < 6; i++) {
+                SIM_CHECK(runtime.getRegister(i) == fixed.getRegister(i));
+            }
+            SIM_CHECK(runtime.getActualFrequencyHz() == fixed.getActualFrequencyHz());
+            SIM_CHECK(fixed.verifyRegisters());
+        }
+    }
+}
+
+template <class T>
+static double benchmark(T &synth) {
+    const uint32_t calls = 200000;
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < calls; n++) {
+        synth.setFrequencyHz(2200000000ULL + (uint64_t)(n % 20000) * 100000ULL, 10000UL);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / calls;
+}
+
+int main() {
+    ADF4351T<SIM_LE_PIN, 25000000UL> a;
+    compare(a, 25000000UL, 1, 0, 0);
+    ADF4351T<SIM_LE_PIN, 10000000UL, 1, 1, 0> b;
+    compare(b, 10000000UL, 1, 1, 0);
+    ADF4351T<SIM_LE_PIN, 122880000UL, 5, 0, 1> c;
+    compare(c, 122880000UL, 5, 0, 1);
+    
+    ADF4351 runtime(SIM_LE_PIN);
+    runtime.beginHz(25000000UL);
+    ADF4351T<SIM_LE_PIN, 25000000UL> fixed;
+    fixed.begin();
+    
+    // Both share the update path: an in-band hop writes the same words
+    runtime.setFrequencyHz(2401000000ULL);
+    fixed.setFrequencyHz(2401000000ULL);
+    uint32_t words = simChip.words;
+    runtime.setFrequencyHz(2402000000ULL);
+    uint32_t runtimeWords = simChip.words - words;
+    words = simChip.words;
+    fixed.setFrequencyHz(2402000000ULL);
+    SIM_CHECK(simChip.words - words == runtimeWords);
+    SIM_CHECK(runtimeWords == 1);
+    for (uint8_t i = 0; i < 6; i++) {
+        SIM_CHECK(simChip.reg[i] == fixed.getRegister(i));
+    }
+    
+    // ... ends a sweep and restarts the lock timer
+    SIM_CHECK(fixed.beginSweepHz(2400000000ULL, 1000000L));
+    SIM_CHECK(fixed.setFrequencyHz(2500000000ULL));
+    SIM_CHECK(!fixed.nextSweepStep());
+    simMicros += 100000;
+    SIM_CHECK(fixed.setFrequencyHz(2600000000ULL));
+    SIM_CHECK(fixed.waitForLock(SIM_LD_PIN, 1000));
+    
+    // Warm start restores a state saved with the same reference only
+    ADF4351SavedState state;
+    SIM_CHECK(fixed.setFrequencyHz(2400500000ULL));
+    SIM_CHECK(fixed.saveState(state));
+    ADF4351T<SIM_LE_PIN, 25000000UL> restored;
+    simReset();
+    SIM_CHECK(restored.begin(state));
+    for (uint8_t i = 0; i < 6; i++) {
+        SIM_CHECK(simChip.reg[i] == state.regs[i]);
+    }
+    SIM_CHECK(restored.verifyRegisters());
+    SIM_CHECK(restored.getActualFrequencyHz() == fixed.getActualFrequencyHz());
+    SIM_CHECK(restored.setFrequencyHz(2401000000ULL));
+    SIM_CHECK(restored.verifyRegisters());
+    
+    ADF4351 other(SIM_LE_PIN);
+    other.beginHz(10000000UL);
+    SIM_CHECK(other.setFrequencyHz(2400500000ULL));
+    SIM_CHECK(other.saveState(state));
+    uint32_t before = simChip.words;
+    SIM_CHECK(!restored.begin(state));
+    SIM_CHECK(simChip.words == before);
+    ADF4351T<SIM_LE_PIN, 10000000UL, 2> halved;
+    SIM_CHECK(!halved.begin(state));
+    ADF4351T<SIM_LE_PIN, 10000000UL> same;
+    SIM_CHECK(same.begin(state));
+    SIM_CHECK(same.verifyRegisters());
+    
+    double runtimeNs = benchmark(runtime);
+    double fixedNs = benchmark(fixed);
+    printf("setFrequencyHz: ADF4351 %.0f ns/call, ADF4351T %.0f ns/call (host, including the SPI stand-in)\n",
+           runtimeNs, fixedNs);
+    
+    return simFinish("template");
+}
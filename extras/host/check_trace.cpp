@@ -0,0 +1,112 @@
+/*
+ * check_trace.cpp - trace ring and dumpTrace() format (built with ADF4351_TRACE_SIZE=16)
+ *
+ * The ring must keep the newest entries in order once it wraps, register
+ * writes must be recorded with their words, and dumpTrace() must emit the
+ * documented binary layout for exactly the entries getTraceEntry() gives.
+ */
+
+#include <vector>
+#include "ADF4351.h"
+#include "sim.h"
+
+// Collects everything written to it
+class Capture : public Print {
+public:
+    std::vector<uint8_t> bytes;
+    
+    size_t write(uint8_t b) {
+        bytes.push_back(b);
+        return 1;
+    }
+};
+
+static uint32_t le32(const uint8_t *p) {
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Dump the ring and compare every field against getTraceEntry()
+static void checkDump(ADF4351 &synth) {
+    Capture out;
+    synth.dumpTrace(out);
+    uint16_t count = synth.getTraceCount();
+    SIM_CHECK(out.bytes.size() == 7 + 9 * (size_t)count);
+    if (out.bytes.size() != 7 + 9 * (size_t)count) {
+        return;
+    }
+    
+    const uint8_t *p = &out.bytes[0];
+    SIM_CHECK(p[0] == 'A' && p[1] == 'D' && p[2] == 'F' && p[3] == 'T');
+    SIM_CHECK(p[4] == 1);
+    SIM_CHECK((p[5] | (p[6] << 8)) == count);
+    for (uint16_t n = 0; n < count; n++) {
+        const uint8_t *e = p + 7 + 9 * n;
+        ADF4351TraceEntry entry;
+        SIM_CHECK(synth.getTraceEntry(n, entry));
+        SIM_CHECK(e[0] == entry.event);
+        SIM_CHECK(le32(e + 1) == entry.timeUs);
+        SIM_CHECK(le32(e + 5) == entry.value);
+    }
+}
+
+int main() {
+    SIM_CHECK(ADF4351_TRACE_SIZE == 16);
+    ADF4351 synth(SIM_LE_PIN);
+    synth.beginHz(25000000UL);
+    
+    ADF4351TraceEntry entry;
+    SIM_CHECK(synth.getTraceCount() == 1);
+    SIM_CHECK(synth.getTraceEntry(0, entry));
+    SIM_CHECK(entry.event == ADF4351_TRACE_BEGIN && entry.value == 25000000UL);
+    
+    // A full update: the call, then R5 down to R0 with their words
+    synth.clearTrace();
+    SIM_CHECK(synth.getTraceCount() == 0);
+    SIM_CHECK(!synth.getTraceEntry(0, entry));
+    SIM_CHECK(synth.setFrequencyHz(2400000000ULL));
+    SIM_CHECK(synth.getTraceCount() == 7);
+    SIM_CHECK(synth.getTraceEntry(0, entry));
+    SIM_CHECK(entry.event == ADF4351_TRACE_SET_FREQUENCY && entry.value == 2400000UL);
+    for (uint8_t n = 1; n <= 6; n++) {
+        SIM_CHECK(synth.getTraceEntry(n, entry));
+        SIM_CHECK(entry.event == 6 - n);
+        SIM_CHECK(entry.value == synth.getRegister(6 - n));
+    }
+    checkDump(synth);
+    
+    // 40 events into 16 slots: the newest 16 remain, oldest first, and
+    // time never runs backwards
+    synth.clearTrace();
+    for (uint8_t n = 0; n < 40; n++) {
+        synth.setOutputPower(n & 3);
+        synth.setChargePumpCurrent(n & 15);
+    }
+    SIM_CHECK(synth.getTraceCount() == 16);
+    SIM_CHECK(!synth.getTraceEntry(16, entry));
+    uint32_t lastUs = 0;
+    for (uint8_t n = 0; n < 16; n++) {
+        uint8_t call = 80 - 16 + n;
+        SIM_CHECK(synth.getTraceEntry(n, entry));
+        if (call & 1) {
+            SIM_CHECK(entry.event == ADF4351_TRACE_SET_CP_CURRENT && entry.value == ((call / 2) & 15));
+        } else {
+            SIM_CHECK(entry.event == ADF4351_TRACE_SET_POWER && entry.value == ((call / 2) & 3));
+        }
+        SIM_CHECK(n == 0 || entry.timeUs >= lastUs);
+        lastUs = entry.timeUs;
+    }
+    checkDump(synth);
+    
+    // Signed values keep their two's complement bits
+    synth.clearTrace();
+    SIM_CHECK(synth.setReferenceCorrectionPpb(-1500));
+    SIM_CHECK(synth.getTraceEntry(0, entry));
+    SIM_CHECK(entry.event == ADF4351_TRACE_SET_CORRECTION && (int32_t)entry.value == -1500);
+    checkDump(synth);
+    
+    // An empty ring dumps just the header
+    synth.clearTrace();
+    checkDump(synth);
+    
+    return simFinish("trace");
+}
@@ -0,0 +1,168 @@
+/*
+ * check_warmstart.cpp - saveState() / begin(state) through a file
+ *
+ * A state written to a file and read back after the chip loses power must
+ * restore the same words, frequency and settings (reference correction
+ * included), a damaged state must be refused before anything reaches the
+ * bus, and the start-up time of a warm start is compared with a cold one.
+ */
+
+#include <chrono>
+#include <stddef.h>
+#include <stdio.h>
+#include "ADF4351.h"
+#include "sim.h"
+
+static bool store(FILE *file, const ADF4351SavedState &state) {
+    rewind(file);
+    return fwrite(&state, sizeof(state), 1, file) == 1 && fflush(file) == 0;
+}
+
+static bool load(FILE *file, ADF4351SavedState &state) {
+    rewind(file);
+    return fread(&state, sizeof(state), 1, file) == 1;
+}
+
+// The documented checksum, worked out independently of the driver
+static uint16_t fletcher16(const ADF4351SavedState &state) {
+    const uint8_t *bytes = (const uint8_t *)&state;
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    for (size_t n = 0; n < offsetof(ADF4351SavedState, checksum); n++) {
+        sum1 = (sum1 + bytes[n]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return (sum2 << 8) | sum1;
+}
+
+// Settings of the programmed instance, applied before a cold start
+static void configure(ADF4351 &synth) {
+    synth.setReferenceHz(25000000UL, 2, 1, 0);
+    synth.beginHz(25000000UL);
+    synth.setOutputPower(1);
+    synth.setChargePumpCurrent(11);
+    synth.setReferenceCorrectionPpb(-2500);
+}
+
+// A damaged state is refused with nothing written
+static void expectRefused(const ADF4351SavedState &state) {
+    ADF4351 synth(SIM_LE_PIN);
+    uint32_t words = simChip.words;
+    uint32_t transactions = simChip.transactions;
+    SIM_CHECK(!synth.begin(state));
+    SIM_CHECK(simChip.words == words);
+    SIM_CHECK(simChip.transactions == transactions);
+    SIM_CHECK(simBus.bits == 0);
+}
+
+int main() {
+    FILE *file = tmpfile();
+    SIM_CHECK(file != NULL);
+    if (file == NULL) {
+        return simFinish("warmstart");
+    }
+    
+    ADF4351 synth(SIM_LE_PIN);
+    ADF4351SavedState state;
+    synth.beginHz(25000000UL);
+    SIM_CHECK(!synth.saveState(state));
+    configure(synth);
+    SIM_CHECK(synth.setFrequencyHz(2401234567ULL, 1000UL));
+    SIM_CHECK(synth.saveState(state));
+    SIM_CHECK(state.checksum == fletcher16(state));
+    SIM_CHECK(store(file, state));
+    
+    // Power cycle: the chip forgets everything, then a new instance
+    // restores from the file
+    simReset();
+    ADF4351SavedState loaded;
+    SIM_CHECK(load(file, loaded));
+    ADF4351 restored(SIM_LE_PIN);
+    uint32_t startUs = simMicros;
+    SIM_CHECK(restored.begin(loaded));
+    uint32_t warmUs = simMicros - startUs;
+    SIM_CHECK(simChip.words == 6);
+    SIM_CHECK(simChip.transactions == 1);
+    SIM_CHECK(simChip.latched == 0x3F);
+    for (uint8_t i = 0; i < 6; i++) {
+        SIM_CHECK(restored.getRegister(i) == synth.getRegister(i));
+        SIM_CHECK(simChip.reg[i] == synth.getRegister(i));
+    }
+    SIM_CHECK(restored.verifyRegisters());
+    SIM_CHECK(restored.getFrequencyHz() == 2401234567ULL);
+    SIM_CHECK(restored.getActualFrequencyHz() == synth.getActualFrequencyHz());
+    SIM_CHECK(restored.getReferenceCorrectionPpb() == -2500);
+    SIM_CHECK(restored.getPFDFrequencyHz() == synth.getPFDFrequencyHz());
+    
+    // The settings come back too: both instances compute the same words
+    // for the next retune
+    SIM_CHECK(synth.setFrequencyHz(868300000ULL, 1000UL));
+    SIM_CHECK(restored.setFrequencyHz(868300000ULL, 1000UL));
+    for (uint8_t i = 0; i < 6; i++) {
+        SIM_CHECK(restored.getRegister(i) == synth.getRegister(i));
+    }
+    SIM_CHECK(restored.getActualFrequencyHz() == synth.getActualFrequencyHz());
+    
+    // Damage in the file: a payload bit, the checksum, the magic or the version
+    ADF4351SavedState damaged = state;
+    damaged.regs[0] ^= 1UL << 15;
+    SIM_CHECK(store(file, damaged));
+    SIM_CHECK(load(file, loaded));
+    simBusReset();
+    expectRefused(loaded);
+    damaged = state;
+    damaged.refCorrectionPpb = 2500;
+    expectRefused(damaged);
+    damaged = state;
+    damaged.checksum ^= 0x0100;
+    expectRefused(damaged);
+    damaged = state;
+    damaged.magic[3] = 'X';
+    damaged.checksum = fletcher16(damaged);
+    expectRefused(damaged);
+    damaged = state;
+    damaged.version = 1;
+    damaged.checksum = fletcher16(damaged);
+    expectRefused(damaged);
+    
+    // Start-up time: cold start programs the settings and computes the
+    // words; warm start checks the saved words and writes them as they
+    // are. Both put the same six words through the bus model, which is
+    // most of the host time.
+    SIM_CHECK(store(file, state));
+    simReset();
+    ADF4351 cold(SIM_LE_PIN);
+    configure(cold);
+    SIM_CHECK(cold.setFrequencyHz(2401234567ULL, 1000UL));
+    SIM_CHECK(simChip.words == 6);
+    for (uint8_t i = 0; i < 6; i++) {
+        SIM_CHECK(simChip.reg[i] == state.regs[i]);
+    }
+    
+    const uint32_t runs = 100000;
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < runs; n++) {
+        ADF4351 synth(SIM_LE_PIN);
+        configure(synth);
+        synth.setFrequencyHz(2401234567ULL, 1000UL);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < runs; n++) {
+        load(file, loaded);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < runs; n++) {
+        ADF4351 synth(SIM_LE_PIN);
+        synth.begin(loaded);
+    }
+    auto t3 = std::chrono::steady_clock::now();
+    SIM_CHECK(load(file, loaded) && loaded.checksum == state.checksum);
+    double coldNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / runs;
+    double readNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / runs;
+    double warmNs = std::chrono::duration<double, std::nano>(t3 - t2).count() / runs;
+    printf("start-up: cold %.0f ns, warm %.0f ns + %.0f ns to read %u bytes from the file (host); %u us simulated\n",
+           coldNs, warmNs, readNs, (unsigned)sizeof(state), warmUs);
+    
+    fclose(file);
+    return simFinish("warmstart");
+}
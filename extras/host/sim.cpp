@@ -0,0 +1,252 @@
+/*
+ * sim.cpp - host Arduino/SPI stand-ins and the ADF4351 chip model
+ */
+
+#include "Arduino.h"
+#include "SPI.h"
+#include "sim.h"
+#include "ADF4351.h"
+
+SPIClass SPI;
+SimChip simChip;
+SimBus simBus;
+uint32_t simMicros = 0;
+uint32_t simLockUs = 40;
+uint32_t simGpioNs = 0;
+int (*simDigitalRead)(uint8_t pin) = NULL;
+void (*simTransferHook)() = NULL;
+bool simInterruptsEnabled = true;
+int simFailures = 0;
+
+const uint16_t simTimingNs[7] = {20, 10, 10, 25, 25, 10, 20};
+
+// Nanoseconds past simMicros
+static uint32_t subNs = 0;
+static uint32_t busClockHz = 1000000UL;
+
+// Serial interface state: pin levels, the time of the last edge of each
+// kind, and the bits clocked in since LE fell
+static uint8_t leLevel = HIGH;
+static uint8_t mosiLevel = LOW;
+static bool leRoseOnce = false;
+static bool clockedSinceLe = false;
+static uint64_t leFallNs = 0;
+static uint64_t leRiseNs = 0;
+static uint64_t sckRiseNs = 0;
+static uint64_t sckFallNs = 0;
+static uint64_t mosiNs = 0;
+static uint32_t shiftIn = 0;
+static uint8_t bitsIn = 0;
+
+static uint64_t nowNs() {
+    return (uint64_t)simMicros * 1000 + subNs;
+}
+
+static void advanceNs(uint32_t ns) {
+    subNs += ns;
+    simMicros += subNs / 1000;
+    subNs %= 1000;
+}
+
+// Record one measurement of t<n> (1-7)
+static void timing(uint8_t n, uint64_t ns) {
+    uint32_t t = (ns > 0xFFFFFFFFULL) ? 0xFFFFFFFFUL : (uint32_t)ns;
+    if (t < simBus.minNs[n - 1]) simBus.minNs[n - 1] = t;
+    if (t < simTimingNs[n - 1]) simBus.violations[n - 1]++;
+}
+
+static void leEdge(uint8_t level) {
+    uint64_t t = nowNs();
+    if (level == LOW) {
+        if (leRoseOnce) {
+            timing(7, t - leRiseNs);
+        }
+        leFallNs = t;
+        clockedSinceLe = false;
+        bitsIn = 0;
+        return;
+    }
+    
+    if (clockedSinceLe) {
+        timing(6, t - sckRiseNs);
+    }
+    leRiseNs = t;
+    leRoseOnce = true;
+    if (bitsIn != 32) {
+        simBus.badWords++;
+        return;
+    }
+    
+    uint8_t index = shiftIn & 0x7;
+    if (index < 6) {
+        simChip.reg[index] = shiftIn;
+        simChip.latched |= (1 << index);
+        simChip.words++;
+        if (index == 0) {
+            simChip.r0Us = simMicros;
+        }
+    }
+}
+
+static void mosiEdge(uint8_t level) {
+    if (level == mosiLevel) {
+        return;
+    }
+    uint64_t t = nowNs();
+    if (clockedSinceLe) {
+        timing(3, t - sckRiseNs);
+    }
+    mosiLevel = level;
+    mosiNs = t;
+}
+
+static void sckRise() {
+    uint64_t t = nowNs();
+    if (leLevel == LOW) {
+        if (!clockedSinceLe) {
+            timing(1, t - leFallNs);
+        } else {
+            timing(5, t - sckFallNs);
+        }
+    }
+    timing(2, t - mosiNs);
+    
+    shiftIn = (shiftIn << 1) | mosiLevel;
+    if (bitsIn < 0xFF) bitsIn++;
+    simBus.bits++;
+    clockedSinceLe = true;
+    sckRiseNs = t;
+}
+
+static void sckFall() {
+    uint64_t t = nowNs();
+    timing(4, t - sckRiseNs);
+    sckFallNs = t;
+}
+
+void simBusReset() {
+    memset(&simBus, 0, sizeof(simBus));
+    for (uint8_t n = 0; n < 7; n++) {
+        simBus.minNs[n] = 0xFFFFFFFFUL;
+    }
+    simBus.startNs = nowNs();
+}
+
+uint32_t simBusViolations() {
+    uint32_t count = simBus.badWords;
+    for (uint8_t n = 0; n < 7; n++) {
+        count += simBus.violations[n];
+    }
+    return count;
+}
+
+double simBusUtilization() {
+    uint64_t elapsedNs = nowNs() - simBus.startNs;
+    return elapsedNs ? 100.0 * simBus.clockNs / elapsedNs : 0.0;
+}
+
+void simBusReport(const char *label) {
+    printf("%s: %u bits, utilization %.1f%%, min t1..t7", label, simBus.bits, simBusUtilization());
+    for (uint8_t n = 0; n < 7; n++) {
+        if (simBus.minNs[n] == 0xFFFFFFFFUL) {
+            printf(" -");
+        } else {
+            printf(" %u", simBus.minNs[n]);
+        }
+    }
+    printf(" ns, %u violations\n", simBusViolations());
+}
+
+void simReset() {
+    memset(&simChip, 0, sizeof(simChip));
+    simLockUs = 40;
+    simDigitalRead = NULL;
+    simTransferHook = NULL;
+    shiftIn = 0;
+    bitsIn = 0;
+    simBusReset();
+}
+
+bool simPoweredDown() {
+    return ((simChip.reg[2] >> 5) & 1) || ((simChip.reg[4] >> 11) & 1);
+}
+
+uint64_t simOutputHz(uint32_t refFreqHz) {
+    ADF4351RegisterInfo info;
+    ADF4351::decodeRegisters(simChip.reg, info);
+    return ADF4351::calcOutputFrequencyHz(info, refFreqHz);
+}
+
+int simFinish(const char *name) {
+    printf("%s: %s (%d failed)\n", name, simFailures ? "FAIL" : "ok", simFailures);
+    return simFailures ? 1 : 0;
+}
+
+uint32_t micros() {
+    return simMicros++;
+}
+
+void delayMicroseconds(unsigned int us) {
+    simMicros += us;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    // The pin changes at the end of the call
+    advanceNs(simGpioNs);
+    if (pin != SIM_LE_PIN || value == leLevel) {
+        return;
+    }
+    leLevel = value;
+    leEdge(value);
+}
+
+int digitalRead(uint8_t pin) {
+    if (simDigitalRead) {
+        return simDigitalRead(pin);
+    }
+    return (!simPoweredDown() && simMicros - simChip.r0Us >= simLockUs) ? HIGH : LOW;
+}
+
+void noInterrupts() {
+    simInterruptsEnabled = false;
+}
+
+void interrupts() {
+    simInterruptsEnabled = true;
+}
+
+void SPIClass::beginTransaction(SPISettings settings) {
+    busClockHz = settings.clockHz;
+    simChip.transactions++;
+}
+
+void SPIClass::endTransaction() {
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+    // Mode 0, MSB first: MOSI changes on the falling edge (or before the
+    // first clock) and is sampled on the rising edge
+    uint32_t highNs = 500000000UL / busClockHz;
+    uint32_t lowNs = 1000000000UL / busClockHz - highNs;
+    for (int8_t bit = 7; bit >= 0; bit--) {
+        mosiEdge((data >> bit) & 1);
+        advanceNs(lowNs);
+        sckRise();
+        advanceNs(highNs);
+        sckFall();
+        simBus.clockNs += lowNs + highNs;
+    }
+    
+    if (simTransferHook != NULL && simInterruptsEnabled) {
+        void (*hook)() = simTransferHook;
+        simTransferHook = NULL;
+        hook();
+        simTransferHook = hook;
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * sim.h - ADF4351 chip model behind the host Arduino/SPI stand-ins
+ *
+ * SPI bytes are expanded into timestamped MOSI and SCK edges. The model
+ * clocks each bit into a 32-bit shift register and latches it on the
+ * rising LE edge, the way the part does, so checks compare what the chip
+ * would hold against the driver's shadow registers. Every edge is timed
+ * against the datasheet serial interface limits (t1..t7).
+ */
+
+#ifndef ADF4351_SIM_H
+#define ADF4351_SIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// LE pin the checks construct the driver with
+#define SIM_LE_PIN 10
+
+// Lock detect pin the checks pass to waitForLock() and friends
+#define SIM_LD_PIN 7
+
+struct SimChip {
+    uint32_t reg[6];            // Latched register words (indexed R0-R5)
+    uint8_t latched;            // Bit mask of registers latched since simReset()
+    uint32_t words;             // Words latched
+    uint32_t transactions;      // SPI transactions
+    uint32_t r0Us;              // Time of the last R0 latch
+};
+
+extern SimChip simChip;
+
+// Simulated time in microseconds
+extern uint32_t simMicros;
+
+// Lock detect goes high this long after an R0 latch while powered up
+extern uint32_t simLockUs;
+
+// Optional replacement for the lock detect model (NULL for the default)
+extern int (*simDigitalRead)(uint8_t pin);
+
+// Called after each SPI byte while interrupts are enabled, standing in for
+// an interrupt taken mid-transfer (NULL for none; it does not nest)
+extern void (*simTransferHook)();
+
+// Time each digitalWrite() takes in ns (0 models an ideal pin)
+extern uint32_t simGpioNs;
+
+// Serial interface minimum times t1..t7 in ns (ADF4351 datasheet, Table 2)
+extern const uint16_t simTimingNs[7];
+
+struct SimBus {
+    uint64_t startNs;           // Time of the last simBusReset()
+    uint64_t clockNs;           // Time spent clocking bits
+    uint32_t bits;              // Bits clocked in
+    uint32_t badWords;          // LE rising edges after other than 32 bits (not latched)
+    uint32_t minNs[7];          // Shortest t1..t7 observed (0xFFFFFFFF if never)
+    uint32_t violations[7];     // Edges that broke the t1..t7 minimum
+};
+
+extern SimBus simBus;
+
+// Interrupt mask state as left by noInterrupts()/interrupts()
+extern bool simInterruptsEnabled;
+
+/**
+ * @brief Clear the chip model, the counters, the lock detect override and the transfer hook
+ */
+void simReset();
+
+/**
+ * @brief Restart the bus statistics (simReset() does this too)
+ */
+void simBusReset();
+
+/**
+ * @brief Count the timing violations and partial words since simBusReset()
+ * @return Sum of the t1..t7 violations and bad words
+ */
+uint32_t simBusViolations();
+
+/**
+ * @brief Get the share of time spent clocking bits since simBusReset()
+ * @return Utilization in percent
+ */
+double simBusUtilization();
+
+/**
+ * @brief Print the words, utilization and shortest t1..t7 since simBusReset()
+ * @param label Line prefix
+ */
+void simBusReport(const char *label);
+
+/**
+ * @brief Check the power-down bits of the latched R2 and R4
+ * @return true if either is set
+ */
+bool simPoweredDown();
+
+/**
+ * @brief Decode the latched registers
+ * @param refFreqHz Reference input frequency in Hz
+ * @return Output frequency in Hz, rounded (0 if the fields are invalid)
+ */
+uint64_t simOutputHz(uint32_t refFreqHz);
+
+// Failure reporting shared by the checks
+extern int simFailures;
+
+#define SIM_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            if (simFailures++ < 20) printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+/**
+ * @brief Print the check summary
+ * @param name Check name
+ * @return Process exit status: 0 if every SIM_CHECK passed
+ */
+int simFinish(const char *name);
+
+#endif // ADF4351_SIM_H